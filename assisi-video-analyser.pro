@@ -7,7 +7,7 @@ TARGET = assisi-video-analyser
 DEPENDPATH += .
 INCLUDEPATH += .
 
-CONFIG += link_pkgconfig
+CONFIG += link_pkgconfig thread c++11
 PKGCONFIG = opencv yaml-cpp
 
 QT       += core gui
@@ -17,6 +17,18 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
 HEADERS += animate.hpp qcustomplot.h \
     dialog-run-parameters.hpp
 HEADERS += process-image.hpp
+HEADERS += feature-engine.hpp
+HEADERS += frame-executor.hpp
+HEADERS += frame-source.hpp
+HEADERS += frame-manifest.hpp
+HEADERS += frame-prefetcher.hpp
+HEADERS += frame-pool.hpp
+HEADERS += difference-histograms.hpp
+HEADERS += column-table.hpp
+HEADERS += histogram-index.hpp
+HEADERS += histogram-matrix.hpp
+HEADERS += light-calibration.hpp
+HEADERS += region-map.hpp
 HEADERS += parameters.hpp
 HEADERS += util.hpp
 HEADERS += image.hpp \
@@ -28,6 +40,18 @@ FORMS += video-analyser.ui \
 SOURCES += animate.cpp main.cpp qcustomplot.cpp \
     dialog-run-parameters.cpp
 SOURCES += process-image.cpp
+SOURCES += feature-engine.cpp
+SOURCES += frame-executor.cpp
+SOURCES += frame-source.cpp
+SOURCES += frame-manifest.cpp
+SOURCES += frame-prefetcher.cpp
+SOURCES += frame-pool.cpp
+SOURCES += difference-histograms.cpp
+SOURCES += column-table.cpp
+SOURCES += histogram-index.cpp
+SOURCES += histogram-matrix.cpp
+SOURCES += light-calibration.cpp
+SOURCES += region-map.cpp
 SOURCES += parameters.cpp
 SOURCES += util.cpp
 SOURCES += image.cpp
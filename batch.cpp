@@ -0,0 +1,528 @@
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "experiment.hpp"
+#include "feature-engine.hpp"
+#include "stream.hpp"
+#include "sweep.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+/**
+ * Exit codes of the batch tool.  Errors while computing the features, such as
+ * unreadable frames or cache files, exit with EXIT_FAILURE.
+ */
+enum BatchExitCode {
+	BATCH_USAGE_ERROR = PARAMETERS_USAGE_ERROR,
+	BATCH_NO_FRAMES = 3
+};
+
+/**
+ * Name of the file, in each folder of a campaign, with the messages of the
+ * process that computed its features.
+ */
+#define BATCH_LOG_FILENAME "assisi-video-analyser-batch.log"
+
+/**
+ * An experiment folder of a campaign and the options used only for it.
+ */
+struct CampaignFolder
+{
+	string folder;
+	vector<string> options;
+	unsigned int number_frames;
+	const char *status;
+	int exit_code;
+	double seconds;
+};
+
+static void usage (const char *program)
+{
+	fprintf (stderr,
+	         "Usage: %s [OPTION]... [FOLDER]...\n"
+	         "Compute the features of the video frames in a folder and write their caches,\n"
+	         "without the graphical user interface.  The light calibrated features are only\n"
+	         "computed if a rectangle is given.\n"
+	         "\n"
+	         "  -p, --folder=FOLDER               folder with the video frames\n"
+	         "  -f, --frame-file-type=TYPE        file type of the video frames\n"
+	         "  -n, --frame-name=TEMPLATE         template of the video frame file names\n"
+	         "  -v, --video=FILE                  read the frames from a video file\n"
+	         "  -r, --number-ROIs=N               number of regions of interest\n"
+	         "  -c, --same-colour-threshold=T     same colour threshold\n"
+	         "  -d, --delta-frame=N               frame gap of the bee speed\n"
+	         "  -D, --delta-frames=N,...          other frame gaps of the raw bee speed\n"
+	         "  -R, --rectangle=X1,Y1,X2,Y2       rectangle used in light calibration\n"
+	         "  -t, --threads=N                   number of threads\n"
+	         "  -a, --readahead=N                 number of frames decoded ahead\n"
+	         "  -k, --chunk-size=N                frames per chunk of the pixel count difference\n"
+	         "  -K, --checkpoint=N                frames between checkpoints of the caches\n"
+	         "  -F, --frame-range=START:END       only process the frames in this range\n"
+	         "  -P, --pack-frames                 pack the frames in a single file first\n"
+	         "  -V, --verify-frames               check every frame of the frame manifest,\n"
+	         "                                    not only the first and last ones\n"
+	         "  -h, --help                        show this help\n"
+	         "\n"
+	         "Several experiment folders, a campaign, are processed if they are given as\n"
+	         "arguments or in a list file.  The options above apply to every folder.\n"
+	         "\n"
+	         "      --folder-list=FILE            file with a folder per line, optionally\n"
+	         "                                    followed by options for that folder only\n"
+	         "      --jobs=N                      number of folders processed at the same time\n"
+	         "      --summary=FILE                write a report of the campaign to FILE\n"
+	         "\n"
+	         "A run with a frame range writes shard files of the caches, primed with the\n"
+	         "frames before the range.  Once the shards of all frames are computed, on this\n"
+	         "or other machines, the caches are assembled by a run with option:\n"
+	         "\n"
+	         "      --merge                       merge the shard files into the caches\n"
+	         "\n"
+	         "A parameter sweep evaluates every combination of same colour threshold, frame\n"
+	         "gap, pre-processing method and rectangle of a grid in a single pass over the\n"
+	         "frames of a folder.  The grid is a YAML file with lists of values for keys\n"
+	         "same-colour-threshold, delta-frame, method and rectangle.  Methods are raw,\n"
+	         "histogram-equalization, PLSM and LC.  Missing keys take the value of the\n"
+	         "options above.\n"
+	         "\n"
+	         "      --sweep=GRID                  evaluate the combinations of the grid file\n"
+	         "      --sweep-output=FILE           write the results to FILE instead of file\n"
+	         "                                    sweep.csv in the folder\n"
+	         "\n"
+	         "A stream analyses the frames of a running experiment as they are produced and\n"
+	         "writes a line per frame with the pixel count difference of each region of\n"
+	         "interest and the latency since the frame was produced.  Frames are read from\n"
+	         "the folder as they are written to it, or from a video file, stream URL or\n"
+	         "camera number.  The stream runs until the source ends or it is interrupted.\n"
+	         "\n"
+	         "      --stream[=SOURCE]             analyse the frames as they are produced\n"
+	         "      --stream-output=OUTPUT        write the lines to file OUTPUT, - for the\n"
+	         "                                    standard output, or to the clients of\n"
+	         "                                    local socket PATH if OUTPUT is unix:PATH\n"
+	         "      --stream-format=FORMAT        ndjson, the default, or csv\n"
+	         "\n"
+	         "Folders whose caches are valid are skipped.  The threads are shared among the\n"
+	         "folders being processed and the folders with more frames start first.  The\n"
+	         "messages of each folder are written to file " BATCH_LOG_FILENAME " in it.\n"
+	         "Folders with invalid options or frames are reported as failed.\n"
+	         "\n"
+	         "Exit status is 0 if all features were computed, %d if the arguments are\n"
+	         "invalid, %d if there are no video frames and %d on other errors.  In a\n"
+	         "campaign it is %d if any folder failed or has no video frames.\n",
+	         program, BATCH_USAGE_ERROR, BATCH_NO_FRAMES, EXIT_FAILURE, EXIT_FAILURE);
+}
+
+/**
+ * Parse the given arguments as the parameters of an experiment.
+ */
+static UserParameters parse_parameters (vector<string> arguments)
+{
+	vector<char *> argv;
+	for (string &argument : arguments)
+		argv.push_back (&argument [0]);
+	argv.push_back (NULL);
+	optind = 0;
+	return UserParameters::parse (argv.size () - 1, argv.data ());
+}
+
+/**
+ * Read a campaign folder list.  Each line has a folder and options for it.
+ * Empty lines and lines starting with # are ignored.
+ */
+static bool read_folder_list (const char *filename, vector<CampaignFolder> &folders)
+{
+	ifstream file (filename);
+	if (!file) {
+		fprintf (stderr, "Could not read folder list %s!\n", filename);
+		return false;
+	}
+	string line;
+	while (getline (file, line)) {
+		istringstream words (line);
+		string folder;
+		if (!(words >> folder) || folder [0] == '#')
+			continue;
+		CampaignFolder item = {folder, {}, 0, "pending", 0, 0};
+		string option;
+		while (words >> option)
+			item.options.push_back (option);
+		folders.push_back (item);
+	}
+	return true;
+}
+
+/**
+ * Compute the features of the experiment with the given parameters.
+ */
+static int compute_features (UserParameters &parameters)
+{
+	if (parameters.number_frames == 0) {
+		fprintf (stderr, "There are no video frames to analyse in folder %s!\n", parameters.folder.c_str ());
+		return BATCH_NO_FRAMES;
+	}
+	fprintf (stderr, "Computing the features of %u video frames\n", parameters.number_frames);
+	Experiment experiment (parameters);
+	if (parameters.has_rectangle ())
+		experiment.set_rect_data (parameters.x1, parameters.y1, parameters.x2, parameters.y2);
+	else
+		fprintf (stderr, "No rectangle given, skipping the light calibrated features\n");
+	fprintf (stderr, "All features computed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Evaluate the combinations of the given parameter sweep grid on the
+ * experiment with the given parameters.
+ */
+static int compute_sweep (UserParameters &parameters, const char *grid_filename, const char *output_filename)
+{
+	if (parameters.number_frames == 0) {
+		fprintf (stderr, "There are no video frames to analyse in folder %s!\n", parameters.folder.c_str ());
+		return BATCH_NO_FRAMES;
+	}
+	SweepGrid grid = SweepGrid::read (grid_filename, parameters);
+	string filename = output_filename != NULL
+	      ? string (output_filename)
+	      : parameters.folder + (parameters.folder.back () == '/' ? "" : "/") + "sweep.csv";
+	Experiment experiment (parameters, false);
+	FeatureEngine engine (parameters);
+	schedule_sweep (experiment, grid, filename, &engine);
+	engine.run ();
+	fprintf (stderr, "Parameter sweep done\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Analyse the frames of a running experiment as they are produced.
+ */
+static int compute_stream (UserParameters &parameters, const char *source_name, const char *output_name, bool csv)
+{
+	Experiment experiment (parameters, false);
+	LiveFrameSource *source = LiveFrameSource::create (source_name, parameters.folder, FrameNaming (parameters.frame_name_template, parameters.frame_file_type));
+	StreamOutput output (output_name);
+	run_stream (experiment, source, &output, csv);
+	delete source;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Merge the shard files of the caches of the experiment with the given
+ * parameters.
+ */
+static int merge_shards (const UserParameters &parameters)
+{
+	if (parameters.number_frames == 0) {
+		fprintf (stderr, "There are no video frames to analyse in folder %s!\n", parameters.folder.c_str ());
+		return BATCH_NO_FRAMES;
+	}
+	fprintf (stderr, "Merging the shards of the caches in folder %s\n", parameters.folder.c_str ());
+	int result = EXIT_SUCCESS;
+	for (const string &filename : Experiment::cache_filenames (parameters))
+		if (!merge_cache_table_shards (parameters, filename) && !valid_cache_table (parameters, filename)) {
+			fprintf (stderr, "  cache %s has neither complete shards nor valid data\n", filename.c_str ());
+			result = EXIT_FAILURE;
+		}
+	return result;
+}
+
+/**
+ * Inspect the folder of a campaign for the process that runs the campaign: write
+ * the number of frames, the number of threads and whether the caches are
+ * valid to the standard output.
+ */
+static int probe_folder (const UserParameters &parameters)
+{
+	vector<string> filenames = Experiment::cache_filenames (parameters);
+	bool valid = parameters.number_frames > 0 && all_of (filenames.begin (), filenames.end (), [&] (const string &filename) {
+		return valid_cache_table (parameters, filename);
+	});
+	printf ("%u %u %d\n", parameters.number_frames, parameters.number_threads, valid ? 1 : 0);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Start a process of this program that computes the features of a folder with
+ * its messages going to the folder log file.  The first process started for a
+ * folder truncates the log file and the others append to it.
+ *
+ * @param output If not -1, descriptor where the standard output of the
+ * process goes.  It is closed in this process.
+ * @return the process identifier or -1 if the process could not be started.
+ */
+static pid_t start_folder (const char *program, const vector<string> &arguments, const string &log_filename, bool truncate, int output = -1)
+{
+	vector<char *> argv;
+	for (const string &argument : arguments)
+		argv.push_back (const_cast<char *> (argument.c_str ()));
+	argv.push_back (NULL);
+	pid_t pid = fork ();
+	if (pid == 0) {
+		int descriptor = open (log_filename.c_str (), O_WRONLY | O_CREAT | (truncate ? O_TRUNC : O_APPEND), 0644);
+		if (descriptor != -1) {
+			dup2 (descriptor, STDERR_FILENO);
+			close (descriptor);
+		}
+		if (output != -1) {
+			dup2 (output, STDOUT_FILENO);
+			close (output);
+		}
+		execv ("/proc/self/exe", argv.data ());
+		execvp (program, argv.data ());
+		_exit (127);
+	}
+	if (output != -1)
+		close (output);
+	return pid;
+}
+
+static string log_filename (const CampaignFolder &item)
+{
+	return item.folder + (item.folder.back () == '/' ? "" : "/") + BATCH_LOG_FILENAME;
+}
+
+static void write_summary (FILE *file, const vector<CampaignFolder> &folders)
+{
+	fprintf (file, "folder,frames,status,exit code,seconds\n");
+	for (const CampaignFolder &item : folders)
+		fprintf (file, "%s,%u,%s,%d,%.1f\n", item.folder.c_str (), item.number_frames, item.status, item.exit_code, item.seconds);
+}
+
+/**
+ * Compute the features of the folders of a campaign with a bounded number of
+ * processes.  The common arguments are the options given to this program.
+ */
+static int run_campaign (const char *program, const vector<string> &common_arguments, vector<CampaignFolder> &folders, unsigned int number_jobs, const char *summary_filename)
+{
+	// inspect the folders in probe processes, several at a time, so that a
+	// folder with invalid options or frames fails without ending the campaign
+	typedef chrono::steady_clock Clock;
+	unsigned int number_threads = 0;
+	vector<CampaignFolder *> pending;
+	unsigned int number_probes = number_jobs > 0 ? number_jobs : max (1u, thread::hardware_concurrency () / 4);
+	map<pid_t, pair<CampaignFolder *, int> > probing;
+	size_t next_probe = 0;
+	while (next_probe < folders.size () || !probing.empty ()) {
+		while (next_probe < folders.size () && probing.size () < number_probes) {
+			CampaignFolder &item = folders [next_probe++];
+			vector<string> arguments (common_arguments);
+			arguments.insert (arguments.end (), item.options.begin (), item.options.end ());
+			arguments.push_back ("--folder=" + item.folder);
+			arguments.push_back ("--probe");
+			int descriptors[2];
+			pid_t pid = pipe (descriptors) == 0 ? start_folder (program, arguments, log_filename (item), true, descriptors [1]) : -1;
+			if (pid == -1) {
+				fprintf (stderr, "Could not inspect folder %s!\n", item.folder.c_str ());
+				item.status = "failed";
+				item.exit_code = EXIT_FAILURE;
+				continue;
+			}
+			probing [pid] = make_pair (&item, descriptors [0]);
+		}
+		int status;
+		pid_t pid = wait (&status);
+		if (pid == -1)
+			break;
+		auto found = probing.find (pid);
+		if (found == probing.end ())
+			continue;
+		CampaignFolder &item = *found->second.first;
+		// the probe has exited, so its few bytes of output are in the pipe
+		FILE *output = fdopen (found->second.second, "r");
+		unsigned int folder_threads;
+		int valid;
+		item.exit_code = WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+		if (output == NULL)
+			close (found->second.second);
+		if (item.exit_code == EXIT_SUCCESS && output != NULL && fscanf (output, "%u %u %d", &item.number_frames, &folder_threads, &valid) == 3) {
+			number_threads = max (number_threads, folder_threads);
+			if (item.number_frames == 0) {
+				item.status = "no frames";
+				item.exit_code = BATCH_NO_FRAMES;
+			}
+			else if (valid)
+				item.status = "skipped";
+			else
+				pending.push_back (&item);
+		}
+		else {
+			item.status = "failed";
+			if (item.exit_code == EXIT_SUCCESS)
+				item.exit_code = EXIT_FAILURE;
+		}
+		if (output != NULL)
+			fclose (output);
+		probing.erase (found);
+		fprintf (stderr, "Folder %s has %u frames, %s\n", item.folder.c_str (), item.number_frames, item.status);
+	}
+	if (number_threads == 0)
+		number_threads = max (1u, thread::hardware_concurrency ());
+	// folders with more frames start first, so that the last ones to finish
+	// are short
+	stable_sort (pending.begin (), pending.end (), [] (const CampaignFolder *a, const CampaignFolder *b) {
+		return a->number_frames > b->number_frames;
+	});
+	if (number_jobs == 0)
+		number_jobs = max (1u, number_threads / 4);
+	number_jobs = max (1u, min (number_jobs, (unsigned int) pending.size ()));
+	unsigned int threads_per_job = max (1u, number_threads / number_jobs);
+	fprintf (stderr, "Processing %d folders, %u at a time with %u threads each\n", (int) pending.size (), number_jobs, threads_per_job);
+	map<pid_t, pair<CampaignFolder *, Clock::time_point> > running;
+	size_t next = 0;
+	while (next < pending.size () || !running.empty ()) {
+		while (next < pending.size () && running.size () < number_jobs) {
+			CampaignFolder *item = pending [next++];
+			vector<string> arguments (common_arguments);
+			arguments.push_back ("--threads=" + to_string (threads_per_job));
+			arguments.insert (arguments.end (), item->options.begin (), item->options.end ());
+			arguments.push_back ("--folder=" + item->folder);
+			pid_t pid = start_folder (program, arguments, log_filename (*item), false);
+			if (pid == -1) {
+				fprintf (stderr, "Could not start processing folder %s!\n", item->folder.c_str ());
+				item->status = "failed";
+				item->exit_code = EXIT_FAILURE;
+				continue;
+			}
+			fprintf (stderr, "Started folder %s\n", item->folder.c_str ());
+			item->status = "running";
+			running [pid] = make_pair (item, Clock::now ());
+		}
+		int status;
+		pid_t pid = wait (&status);
+		if (pid == -1)
+			break;
+		auto found = running.find (pid);
+		if (found == running.end ())
+			continue;
+		CampaignFolder *item = found->second.first;
+		item->seconds = chrono::duration<double> (Clock::now () - found->second.second).count ();
+		item->exit_code = WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+		item->status = item->exit_code == EXIT_SUCCESS ? "computed" : "failed";
+		running.erase (found);
+		fprintf (stderr, "Folder %s %s in %.0f seconds, %d folders left\n",
+		         item->folder.c_str (), item->status, item->seconds, (int) (pending.size () - next + running.size ()));
+	}
+	write_summary (stderr, folders);
+	if (summary_filename != NULL) {
+		FILE *file = fopen (summary_filename, "w");
+		if (file == NULL)
+			fprintf (stderr, "Could not create summary file %s!\n", summary_filename);
+		else {
+			write_summary (file, folders);
+			fclose (file);
+		}
+	}
+	for (const CampaignFolder &item : folders)
+		if (item.exit_code != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
+
+int main (int argc, char *argv[])
+{
+	// campaign options are handled here, the others by the option parser
+	vector<string> arguments (1, argv [0]);
+	const char *folder_list = NULL;
+	const char *summary_filename = NULL;
+	unsigned int number_jobs = 0;
+	bool merge = false;
+	const char *sweep_grid = NULL;
+	const char *sweep_output = NULL;
+	const char *stream_source = NULL;
+	const char *stream_output = "-";
+	bool stream_csv = false;
+	bool probe = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp (argv [i], "-h") == 0 || strcmp (argv [i], "--help") == 0) {
+			usage (argv [0]);
+			return EXIT_SUCCESS;
+		}
+		else if (strncmp (argv [i], "--folder-list=", 14) == 0)
+			folder_list = argv [i] + 14;
+		else if (strncmp (argv [i], "--summary=", 10) == 0)
+			summary_filename = argv [i] + 10;
+		else if (strncmp (argv [i], "--jobs=", 7) == 0) {
+			char *end;
+			number_jobs = (unsigned int) strtoul (argv [i] + 7, &end, 10);
+			if (end == argv [i] + 7 || *end != 0 || argv [i][7] == '-') {
+				fprintf (stderr, "Invalid number of jobs %s!\n", argv [i] + 7);
+				return BATCH_USAGE_ERROR;
+			}
+		}
+		else if (strcmp (argv [i], "--merge") == 0)
+			merge = true;
+		// internal option of the processes that inspect the folders of a campaign
+		else if (strcmp (argv [i], "--probe") == 0)
+			probe = true;
+		else if (strncmp (argv [i], "--sweep=", 8) == 0)
+			sweep_grid = argv [i] + 8;
+		else if (strncmp (argv [i], "--sweep-output=", 15) == 0)
+			sweep_output = argv [i] + 15;
+		else if (strcmp (argv [i], "--stream") == 0)
+			stream_source = "";
+		else if (strncmp (argv [i], "--stream=", 9) == 0)
+			stream_source = argv [i] + 9;
+		else if (strncmp (argv [i], "--stream-output=", 16) == 0)
+			stream_output = argv [i] + 16;
+		else if (strncmp (argv [i], "--stream-format=", 16) == 0) {
+			if (strcmp (argv [i] + 16, "csv") != 0 && strcmp (argv [i] + 16, "ndjson") != 0) {
+				fprintf (stderr, "Unknown stream format %s!\n", argv [i] + 16);
+				return BATCH_USAGE_ERROR;
+			}
+			stream_csv = strcmp (argv [i] + 16, "csv") == 0;
+		}
+		else
+			arguments.push_back (argv [i]);
+	}
+	init ();
+	vector<char *> parser_argv;
+	for (string &argument : arguments)
+		parser_argv.push_back (&argument [0]);
+	parser_argv.push_back (NULL);
+	UserParameters parameters = UserParameters::parse (parser_argv.size () - 1, parser_argv.data ());
+	// the parser moves the arguments that are not options to the end
+	vector<CampaignFolder> folders;
+	for (int i = optind; i < (int) parser_argv.size () - 1; i++)
+		folders.push_back (CampaignFolder {parser_argv [i], {}, 0, "pending", 0, 0});
+	if (folder_list != NULL && !read_folder_list (folder_list, folders))
+		return BATCH_USAGE_ERROR;
+	if (stream_source != NULL) {
+		if (folder_list != NULL || !folders.empty () || merge || sweep_grid != NULL) {
+			fprintf (stderr, "A stream is analysed on a single folder given with option --folder!\n");
+			return BATCH_USAGE_ERROR;
+		}
+		return compute_stream (parameters, stream_source, stream_output, stream_csv);
+	}
+	if (sweep_grid != NULL) {
+		if (folder_list != NULL || !folders.empty () || merge) {
+			fprintf (stderr, "A parameter sweep is done on a single folder given with option --folder!\n");
+			return BATCH_USAGE_ERROR;
+		}
+		return compute_sweep (parameters, sweep_grid, sweep_output);
+	}
+	if (folder_list == NULL && folders.empty ())
+		return probe ? probe_folder (parameters) : merge ? merge_shards (parameters) : compute_features (parameters);
+	vector<string> common_arguments (parser_argv.begin (), parser_argv.begin () + optind);
+	if (merge) {
+		int result = EXIT_SUCCESS;
+		for (CampaignFolder &item : folders) {
+			vector<string> arguments (common_arguments);
+			arguments.insert (arguments.end (), item.options.begin (), item.options.end ());
+			arguments.push_back ("--folder=" + item.folder);
+			if (merge_shards (parse_parameters (arguments)) != EXIT_SUCCESS)
+				result = EXIT_FAILURE;
+		}
+		return result;
+	}
+	return run_campaign (argv [0], common_arguments, folders, number_jobs, summary_filename);
+}
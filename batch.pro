@@ -0,0 +1,58 @@
+######################################################################
+# Tool that computes the features of the video frames without the
+# graphical user interface
+######################################################################
+
+TEMPLATE = app
+TARGET = assisi-video-analyser-batch
+DEPENDPATH += .
+INCLUDEPATH += .
+
+CONFIG += console link_pkgconfig thread c++11
+CONFIG -= app_bundle
+PKGCONFIG = opencv yaml-cpp
+
+QT = core
+
+# Input
+HEADERS += process-image.hpp
+HEADERS += feature-engine.hpp
+HEADERS += frame-executor.hpp
+HEADERS += frame-source.hpp
+HEADERS += frame-manifest.hpp
+HEADERS += frame-prefetcher.hpp
+HEADERS += frame-pool.hpp
+HEADERS += difference-histograms.hpp
+HEADERS += column-table.hpp
+HEADERS += histogram-index.hpp
+HEADERS += histogram-matrix.hpp
+HEADERS += light-calibration.hpp
+HEADERS += stream.hpp
+HEADERS += sweep.hpp
+HEADERS += region-map.hpp
+HEADERS += parameters.hpp
+HEADERS += util.hpp
+HEADERS += image.hpp \
+	experiment.hpp \
+	histogram.hpp
+SOURCES += batch.cpp
+SOURCES += process-image.cpp
+SOURCES += feature-engine.cpp
+SOURCES += frame-executor.cpp
+SOURCES += frame-source.cpp
+SOURCES += frame-manifest.cpp
+SOURCES += frame-prefetcher.cpp
+SOURCES += frame-pool.cpp
+SOURCES += difference-histograms.cpp
+SOURCES += column-table.cpp
+SOURCES += histogram-index.cpp
+SOURCES += histogram-matrix.cpp
+SOURCES += light-calibration.cpp
+SOURCES += stream.cpp
+SOURCES += sweep.cpp
+SOURCES += region-map.cpp
+SOURCES += parameters.cpp
+SOURCES += util.cpp
+SOURCES += image.cpp \
+	experiment.cpp \
+	histogram.cpp
@@ -0,0 +1,80 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "column-table.hpp"
+
+using namespace std;
+
+static void usage (const char *program)
+{
+	fprintf (stderr,
+	         "Usage: %s [OPTION]... TABLE [CSV]\n"
+	         "Write the cache table TABLE as comma separated values to file CSV, or to the\n"
+	         "standard output.  Without options the output is the same as the comma\n"
+	         "separated values caches of previous versions.\n"
+	         "\n"
+	         "  -H, --header    write a first line with the column names\n"
+	         "  -l, --list      list the columns and the number of rows instead\n",
+	         program);
+}
+
+int main (int argc, char *argv[])
+{
+	bool header = false;
+	bool list = false;
+	bool ok = true;
+	do {
+		static struct option long_options[] = {
+			{"header", no_argument, 0, 'H'},
+			{"list"  , no_argument, 0, 'l'},
+			{"help"  , no_argument, 0, 'h'},
+			{0,         0,                 0,  0 }
+		};
+		int c = getopt_long (argc, argv, "Hlh", long_options, 0);
+		switch (c) {
+		case -1:
+			ok = false;
+			break;
+		case 'H':
+			header = true;
+			break;
+		case 'l':
+			list = true;
+			break;
+		case 'h':
+			usage (argv [0]);
+			return EXIT_SUCCESS;
+		default:
+			usage (argv [0]);
+			return EXIT_FAILURE;
+		}
+	} while (ok);
+	if (optind >= argc || argc - optind > 2) {
+		usage (argv [0]);
+		return EXIT_FAILURE;
+	}
+	ColumnTable *table = ColumnTable::open (argv [optind]);
+	if (table == NULL) {
+		fprintf (stderr, "Could not read table %s!\n", argv [optind]);
+		return EXIT_FAILURE;
+	}
+	if (!table->complete ())
+		fprintf (stderr, "Table %s is not complete, only %u of %u rows were computed\n", argv [optind], table->number_complete_rows (), table->number_rows ());
+	FILE *file = stdout;
+	if (argc - optind == 2 && (file = fopen (argv [optind + 1], "w")) == NULL) {
+		fprintf (stderr, "Could not create file %s!\n", argv [optind + 1]);
+		return EXIT_FAILURE;
+	}
+	if (list) {
+		fprintf (file, "%u rows, %u complete\n", table->number_rows (), table->number_complete_rows ());
+		for (unsigned int index_column = 0; index_column < table->number_columns (); index_column++)
+			fprintf (file, "%s %u\n", table->column (index_column).name.c_str (), table->column (index_column).width);
+	}
+	else
+		table->write_csv (file, header);
+	if (file != stdout)
+		fclose (file);
+	delete table;
+	return EXIT_SUCCESS;
+}
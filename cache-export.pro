@@ -0,0 +1,16 @@
+######################################################################
+# Tool that exports the binary cache tables to comma separated values
+######################################################################
+
+TEMPLATE = app
+TARGET = cache-export
+DEPENDPATH += .
+INCLUDEPATH += .
+
+CONFIG += console thread c++11
+CONFIG -= qt app_bundle
+
+# Input
+HEADERS += column-table.hpp
+SOURCES += column-table.cpp
+SOURCES += cache-export.cpp
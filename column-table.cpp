@@ -0,0 +1,254 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "column-table.hpp"
+
+using namespace std;
+
+static const char COLUMN_TABLE_MAGIC[4] = {'A', 'V', 'C', 'T'};
+static const char COLUMN_TABLE_FOOTER_MAGIC[4] = {'A', 'V', 'C', 'F'};
+static const uint32_t COLUMN_TABLE_VERSION = 2;
+static const size_t COLUMN_TABLE_NAME_SIZE = 48;
+
+/**
+ * Header of the file, followed by the column descriptors.
+ */
+struct TableHeader {
+	char magic [4];
+	uint32_t version;
+	uint32_t number_rows;
+	uint32_t number_columns;
+};
+
+struct ColumnDescriptor {
+	char name [COLUMN_TABLE_NAME_SIZE];
+	uint32_t width;
+	uint32_t reserved;
+	uint64_t offset;
+};
+
+/**
+ * Footer at the end of the file, after the column values.
+ */
+struct TableFooter {
+	char magic [4];
+	uint32_t number_rows;
+	uint32_t complete_rows;
+	uint32_t reserved;
+	uint64_t parameters_hash;
+	uint64_t frames_hash;
+};
+
+static size_t align (size_t offset)
+{
+	return (offset + COLUMN_TABLE_ALIGNMENT - 1) / COLUMN_TABLE_ALIGNMENT * COLUMN_TABLE_ALIGNMENT;
+}
+
+ColumnTable::ColumnTable ():
+	size (0),
+	data (NULL),
+	rows (0),
+	footer (NULL)
+{
+}
+
+ColumnTable::~ColumnTable ()
+{
+	if (this->data != NULL)
+		munmap (this->data, this->size);
+}
+
+ColumnTable *ColumnTable::create (FILE *file, unsigned int number_rows, const vector<Column> &columns, const Signature &signature)
+{
+	vector<ColumnDescriptor> descriptors (columns.size ());
+	size_t offset = align (sizeof (TableHeader) + columns.size () * sizeof (ColumnDescriptor));
+	for (unsigned int index_column = 0; index_column < columns.size (); index_column++) {
+		ColumnDescriptor &descriptor = descriptors [index_column];
+		memset (&descriptor, 0, sizeof (descriptor));
+		strncpy (descriptor.name, columns [index_column].name.c_str (), COLUMN_TABLE_NAME_SIZE - 1);
+		descriptor.width = columns [index_column].width;
+		descriptor.offset = offset;
+		offset = align (offset + (size_t) number_rows * descriptor.width * sizeof (int32_t));
+	}
+	size_t size = offset + sizeof (TableFooter);
+	ColumnTable *result = new ColumnTable ();
+	result->size = size;
+	result->rows = number_rows;
+	result->columns = columns;
+	int descriptor = fileno (file);
+	// truncating first discards the values of a previous table
+	void *address = ftruncate (descriptor, 0) == 0 && ftruncate (descriptor, size) == 0 ? mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+	if (address == MAP_FAILED) {
+		fprintf (stderr, "Could not create a table with %u rows!\n", number_rows);
+		exit (EXIT_FAILURE);
+	}
+	result->data = (unsigned char *) address;
+	TableHeader header;
+	memcpy (header.magic, COLUMN_TABLE_MAGIC, sizeof (COLUMN_TABLE_MAGIC));
+	header.version = COLUMN_TABLE_VERSION;
+	header.number_rows = number_rows;
+	header.number_columns = columns.size ();
+	memcpy (result->data, &header, sizeof (header));
+	memcpy (result->data + sizeof (header), descriptors.data (), descriptors.size () * sizeof (ColumnDescriptor));
+	for (const ColumnDescriptor &descriptor : descriptors)
+		result->values.push_back ((int32_t *) (result->data + descriptor.offset));
+	result->footer = (TableFooter *) (result->data + offset);
+	memcpy (result->footer->magic, COLUMN_TABLE_FOOTER_MAGIC, sizeof (COLUMN_TABLE_FOOTER_MAGIC));
+	result->footer->number_rows = number_rows;
+	result->footer->complete_rows = 0;
+	result->footer->parameters_hash = signature.parameters;
+	result->footer->frames_hash = signature.frames;
+	return result;
+}
+
+ColumnTable *ColumnTable::resume (FILE *file, unsigned int number_rows, const vector<Column> &columns, const Signature &signature)
+{
+	ColumnTable *result = ColumnTable::map_file (fileno (file), true, "");
+	if (result != NULL && !(result->matches (number_rows, columns) && result->signature () == signature)) {
+		delete result;
+		result = NULL;
+	}
+	return result;
+}
+
+ColumnTable *ColumnTable::open (const string &filename)
+{
+	int descriptor = ::open (filename.c_str (), O_RDONLY);
+	if (descriptor == -1)
+		return NULL;
+	ColumnTable *result = ColumnTable::map_file (descriptor, false, filename);
+	close (descriptor);
+	return result;
+}
+
+/**
+ * Map the file with the given descriptor in memory and parse its table.  The
+ * descriptor can be closed afterwards.  Messages are printed if a file name is
+ * given.
+ */
+ColumnTable *ColumnTable::map_file (int descriptor, bool writable, const string &filename)
+{
+	struct stat status;
+	void *address = MAP_FAILED;
+	if (fstat (descriptor, &status) == 0 && (size_t) status.st_size >= sizeof (TableHeader) + sizeof (TableFooter))
+		address = mmap (NULL, status.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, descriptor, 0);
+	if (address == MAP_FAILED) {
+		if (!filename.empty ())
+			fprintf (stderr, "  could not map table %s, ignoring it\n", filename.c_str ());
+		return NULL;
+	}
+	ColumnTable *result = new ColumnTable ();
+	result->size = status.st_size;
+	result->data = (unsigned char *) address;
+	if (!result->parse (filename)) {
+		delete result;
+		return NULL;
+	}
+	return result;
+}
+
+/**
+ * Read the header, the column descriptors and the footer of the mapped file.
+ * @return false if they are not valid.
+ */
+bool ColumnTable::parse (const string &filename)
+{
+	TableHeader header;
+	memcpy (&header, this->data, sizeof (header));
+	size_t footer_offset = this->size - sizeof (TableFooter);
+	bool ok =
+	      memcmp (header.magic, COLUMN_TABLE_MAGIC, sizeof (COLUMN_TABLE_MAGIC)) == 0
+	      && header.version == COLUMN_TABLE_VERSION
+	      && sizeof (header) + (size_t) header.number_columns * sizeof (ColumnDescriptor) <= footer_offset;
+	this->rows = header.number_rows;
+	for (unsigned int index_column = 0; ok && index_column < header.number_columns; index_column++) {
+		ColumnDescriptor descriptor;
+		memcpy (&descriptor, this->data + sizeof (header) + index_column * sizeof (ColumnDescriptor), sizeof (descriptor));
+		descriptor.name [COLUMN_TABLE_NAME_SIZE - 1] = 0;
+		ok = descriptor.offset % COLUMN_TABLE_ALIGNMENT == 0
+		      && descriptor.offset + (size_t) header.number_rows * descriptor.width * sizeof (int32_t) <= footer_offset;
+		this->columns.push_back (Column {descriptor.name, descriptor.width});
+		this->values.push_back ((int32_t *) (this->data + descriptor.offset));
+	}
+	this->footer = (TableFooter *) (this->data + footer_offset);
+	ok = ok
+	      && memcmp (this->footer->magic, COLUMN_TABLE_FOOTER_MAGIC, sizeof (COLUMN_TABLE_FOOTER_MAGIC)) == 0
+	      && this->footer->number_rows == this->rows
+	      && this->footer->complete_rows <= this->rows;
+	if (!ok && !filename.empty ())
+		fprintf (stderr, "  file %s does not have a valid table, ignoring it\n", filename.c_str ());
+	return ok;
+}
+
+ColumnTable::Signature ColumnTable::signature () const
+{
+	return Signature {this->footer->parameters_hash, this->footer->frames_hash};
+}
+
+unsigned int ColumnTable::number_complete_rows () const
+{
+	return this->footer->complete_rows;
+}
+
+void ColumnTable::copy_rows (const ColumnTable &other, unsigned int index_first_row, unsigned int number_rows)
+{
+	for (unsigned int index_column = 0; index_column < this->columns.size (); index_column++)
+		memcpy (this->row (index_column, index_first_row), other.row (index_column, index_first_row), (size_t) number_rows * this->columns [index_column].width * sizeof (int32_t));
+}
+
+void ColumnTable::checkpoint (unsigned int number_complete_rows)
+{
+	// the values must be on disk before the footer says they are complete
+	bool ok = msync (this->data, this->size, MS_SYNC) == 0;
+	this->footer->complete_rows = number_complete_rows;
+	ok = ok && msync (this->data, this->size, MS_SYNC) == 0;
+	if (!ok) {
+		fprintf (stderr, "Could not write a table with %u rows to disk!\n", this->rows);
+		exit (EXIT_FAILURE);
+	}
+}
+
+bool ColumnTable::matches (unsigned int number_rows, const vector<Column> &columns) const
+{
+	if (this->rows != number_rows || this->columns.size () != columns.size ())
+		return false;
+	for (unsigned int index_column = 0; index_column < columns.size (); index_column++)
+		if (this->columns [index_column].width != columns [index_column].width)
+			return false;
+	return true;
+}
+
+void ColumnTable::write_csv (FILE *file, bool header) const
+{
+	if (header) {
+		for (unsigned int index_column = 0; index_column < this->columns.size (); index_column++) {
+			const Column &column = this->columns [index_column];
+			if (column.width == 1)
+				fprintf (file, index_column > 0 ? ",%s" : "%s", column.name.c_str ());
+			else
+				for (unsigned int index = 0; index < column.width; index++)
+					fprintf (file, index_column > 0 || index > 0 ? ",%s_%u" : "%s_%u", column.name.c_str (), index);
+		}
+		fprintf (file, "\n");
+	}
+	for (unsigned int index_row = 0; index_row < this->rows; index_row++) {
+		for (unsigned int index_column = 0; index_column < this->columns.size (); index_column++) {
+			const int32_t *values = this->row (index_column, index_row);
+			unsigned int width = this->columns [index_column].width;
+			if (width > 1 && values [0] == -1)
+				width = 1;
+			for (unsigned int index = 0; index < width; index++)
+				fprintf (file, index_column > 0 || index > 0 ? ",%d" : "%d", values [index]);
+		}
+		fprintf (file, "\n");
+	}
+}
+
+string legacy_csv_filename (const string &filename)
+{
+	size_t dot = filename.rfind ('.');
+	return filename.substr (0, dot) + ".csv";
+}
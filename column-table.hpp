@@ -0,0 +1,153 @@
+#ifndef __COLUMN_TABLE__
+#define __COLUMN_TABLE__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct TableFooter;
+
+/**
+ * @brief The ColumnTable class is a binary cache file with one row per video
+ * frame and a fixed set of columns.  Each column holds a fixed number of 32
+ * bit signed integers per row, its width: one for a pixel count difference
+ * value, 256 for a histogram.  The values of a column are stored contiguously
+ * and row after row, so a column is an array that is used directly from the
+ * memory mapped file.
+ *
+ * The file starts with a header with a magic number, a version, the number of
+ * rows and the number of columns, followed by the description of each column:
+ * its name, its width and the offset of its values.  Column values start at
+ * offsets aligned to #COLUMN_TABLE_ALIGNMENT bytes.
+ *
+ * The values are followed by a footer with the signature of the data and the
+ * number of rows that are complete.  A table is written in chunks of rows and
+ * the footer is updated after each chunk is on disk, so a table left behind by
+ * an interrupted run can be resumed after its last complete row.
+ *
+ * A row of a column whose width is greater than one, and whose first value is
+ * -1, has no data.  This is used for the difference to a frame afar that does
+ * not exist.
+ */
+class ColumnTable
+{
+public:
+	struct Column {
+		std::string name;
+		unsigned int width;
+	};
+	/**
+	 * @brief The Signature struct identifies the data in a table: a hash of
+	 * the parameters used to compute it and a hash of the video frames it was
+	 * computed from.
+	 */
+	struct Signature {
+		uint64_t parameters;
+		uint64_t frames;
+		bool operator== (const Signature &other) const
+		{
+			return this->parameters == other.parameters && this->frames == other.frames;
+		}
+	};
+private:
+	size_t size;
+	unsigned char *data;
+	unsigned int rows;
+	std::vector<Column> columns;
+	std::vector<int32_t *> values;
+	TableFooter *footer;
+	ColumnTable ();
+	bool parse (const std::string &filename);
+	static ColumnTable *map_file (int descriptor, bool writable, const std::string &filename);
+public:
+	/**
+	 * Unmaps the file.  Values written to a created table are in the file
+	 * afterwards.
+	 */
+	~ColumnTable ();
+	/**
+	 * @brief create Lay out a table in the given file, which must be open for
+	 * reading and writing, and map it in memory.  Previous contents of the
+	 * file are discarded.  All values start at zero and no row is complete.
+	 */
+	static ColumnTable *create (FILE *file, unsigned int number_rows, const std::vector<Column> &columns, const Signature &signature);
+	/**
+	 * @brief resume Map in memory for writing the table in the given file,
+	 * which must be open for reading and writing.
+	 * @return NULL if the file does not have a table with the given rows,
+	 * columns and signature.
+	 */
+	static ColumnTable *resume (FILE *file, unsigned int number_rows, const std::vector<Column> &columns, const Signature &signature);
+	/**
+	 * @brief open Map the table in the given file in memory for reading.
+	 * @return NULL if the file does not exist or does not have a valid table.
+	 */
+	static ColumnTable *open (const std::string &filename);
+	unsigned int number_rows () const
+	{
+		return this->rows;
+	}
+	unsigned int number_columns () const
+	{
+		return this->columns.size ();
+	}
+	const Column &column (unsigned int index_column) const
+	{
+		return this->columns [index_column];
+	}
+	Signature signature () const;
+	/**
+	 * Return the number of rows, from the first, whose values were
+	 * checkpointed.
+	 */
+	unsigned int number_complete_rows () const;
+	bool complete () const
+	{
+		return this->number_complete_rows () == this->rows;
+	}
+	/**
+	 * @brief copy_rows Copy the values of the given number of rows, from the
+	 * given one, of a table with the same columns.
+	 */
+	void copy_rows (const ColumnTable &other, unsigned int index_first_row, unsigned int number_rows);
+	/**
+	 * @brief checkpoint Flush the values of the table to disk and then record
+	 * that the given number of rows, from the first, are complete.
+	 */
+	void checkpoint (unsigned int number_complete_rows);
+	/**
+	 * @brief matches Return true if the table has the given number of rows and
+	 * columns with the given widths.  The signature is not checked.
+	 */
+	bool matches (unsigned int number_rows, const std::vector<Column> &columns) const;
+	/**
+	 * Return the values of the given row of a column.  Rows start at zero.
+	 */
+	int32_t *row (unsigned int index_column, unsigned int index_row)
+	{
+		return this->values [index_column] + (size_t) index_row * this->columns [index_column].width;
+	}
+	const int32_t *row (unsigned int index_column, unsigned int index_row) const
+	{
+		return this->values [index_column] + (size_t) index_row * this->columns [index_column].width;
+	}
+	/**
+	 * Write the table as comma separated values, one line per row.  A row of a
+	 * column without data is written as a single -1.
+	 */
+	void write_csv (FILE *file, bool header) const;
+};
+
+/**
+ * Values of a column start at multiples of this number of bytes.
+ */
+#define COLUMN_TABLE_ALIGNMENT 64
+
+/**
+ * Return the name of the comma separated values file that was used as cache
+ * before binary tables, given the name of the table.
+ */
+std::string legacy_csv_filename (const std::string &filename);
+
+#endif
@@ -3,6 +3,7 @@
 #include <sys/wait.h>
 
 #include "dialog-run-parameters.hpp"
+#include "frame-manifest.hpp"
 #include "ui_dialog-run-parameters.h"
 
 using namespace std;
@@ -63,7 +64,7 @@ void DialogRunParameters::on_extractFramesPushButton_clicked()
 	string folder = this->get_folder ();
 	string video_path = this->ui->videoWithFramesToAnalyseLineEdit->text ().toStdString ();
 	if ((access (folder.c_str (), F_OK) == 0) && (access (video_path.c_str (), F_OK | R_OK) == 0)) {
-		split_video (video_path, folder, this->ui->framesPerSecondSpinBox->value (), "frames-%4d." + this->get_frame_file_type ());
+		split_video (video_path, folder, this->ui->framesPerSecondSpinBox->value (), DEFAULT_FRAME_NAME_TEMPLATE "." + this->get_frame_file_type ());
 	}
 }
 
@@ -95,6 +96,14 @@ std::string DialogRunParameters::get_frame_file_type () const
 		return "";
 }
 
+std::string DialogRunParameters::get_video_filename () const
+{
+	if (this->ui->readFramesFromVideoCheckBox->isChecked ())
+		return this->ui->videoWithFramesToAnalyseLineEdit->text ().toStdString ();
+	else
+		return "";
+}
+
 int DialogRunParameters::get_number_ROIs () const
 {
 	return this->ui->numberROIsSpinBox->value ();
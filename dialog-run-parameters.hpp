@@ -28,6 +28,11 @@ private slots:
 public:
 	std::string get_folder () const;
 	std::string get_frame_file_type () const;
+	/**
+	 * Return the video to decode frames from, or an empty string if the
+	 * extracted frames are used.
+	 */
+	std::string get_video_filename () const;
 	int get_number_ROIs () const;
 private:
 	Ui::DialogRunParameters *ui;
@@ -0,0 +1,158 @@
+#include <algorithm>
+
+#include "difference-histograms.hpp"
+#include "image.hpp"
+
+using namespace std;
+
+DifferenceHistograms::DifferenceHistograms (unsigned int number_ROIs):
+	number_ROIs (number_ROIs)
+{
+}
+
+size_t DifferenceHistograms::offset (unsigned int index_frame, unsigned int index_ROI, unsigned int kind) const
+{
+	return (((size_t) (index_frame - 1) * this->number_ROIs + index_ROI) * 2 + kind) * (NUMBER_COLOUR_LEVELS + 1);
+}
+
+unsigned int DifferenceHistograms::number_frames () const
+{
+	return this->previous_available.size () / this->number_ROIs;
+}
+
+void DifferenceHistograms::append_frame ()
+{
+	this->tail_counts.resize (this->tail_counts.size () + this->number_ROIs * 2 * (NUMBER_COLOUR_LEVELS + 1), 0);
+	this->previous_available.resize (this->previous_available.size () + this->number_ROIs, false);
+}
+
+void DifferenceHistograms::set (unsigned int index_ROI, Kind kind, const Histogram &histogram)
+{
+	unsigned int index_frame = this->number_frames ();
+	uint32_t *tail = &this->tail_counts [this->offset (index_frame, index_ROI, kind)];
+	tail [NUMBER_COLOUR_LEVELS] = 0;
+	for (int level = NUMBER_COLOUR_LEVELS - 1; level >= 0; level--)
+		tail [level] = tail [level + 1] + (uint32_t) histogram [level];
+	if (kind == PREVIOUS)
+		this->previous_available [(index_frame - 1) * this->number_ROIs + index_ROI] = true;
+}
+
+void DifferenceHistograms::clear ()
+{
+	this->tail_counts.clear ();
+	this->previous_available.clear ();
+}
+
+int DifferenceHistograms::number_different_pixels (unsigned int index_frame, unsigned int index_ROI, Kind kind, unsigned int same_colour_level) const
+{
+	if (kind == PREVIOUS && !this->previous_available [(index_frame - 1) * this->number_ROIs + index_ROI])
+		return -1;
+	return this->tail_counts [this->offset (index_frame, index_ROI, kind) + min (same_colour_level, NUMBER_COLOUR_LEVELS)];
+}
+
+vector<QVector<double> > *DifferenceHistograms::pixel_count_difference (unsigned int same_colour_level) const
+{
+	vector<QVector<double> > *result = new vector<QVector<double> > (2 * this->number_ROIs);
+	unsigned int number_frames = this->number_frames ();
+	for (unsigned int index_ROI = 0; index_ROI < this->number_ROIs; index_ROI++) {
+		QVector<double> &number_bees = (*result) [2 * index_ROI];
+		QVector<double> &bee_speed = (*result) [2 * index_ROI + 1];
+		number_bees.reserve (number_frames);
+		bee_speed.reserve (number_frames);
+		for (unsigned int index_frame = 1; index_frame <= number_frames; index_frame++) {
+			number_bees.append (this->number_different_pixels (index_frame, index_ROI, BACKGROUND, same_colour_level));
+			bee_speed.append (this->number_different_pixels (index_frame, index_ROI, PREVIOUS, same_colour_level));
+		}
+	}
+	return result;
+}
+
+vector<QVector<double> > *DifferenceHistograms::pixel_count_difference (const ColumnTable &table, unsigned int number_ROIs, unsigned int same_colour_level)
+{
+	vector<QVector<double> > *result = new vector<QVector<double> > (2 * number_ROIs);
+	const unsigned int number_frames = table.number_rows ();
+	same_colour_level = min (same_colour_level, NUMBER_COLOUR_LEVELS);
+	for (unsigned int index_column = 0; index_column < 2 * number_ROIs; index_column++) {
+		QVector<double> &data = (*result) [index_column];
+		data.reserve (number_frames);
+		for (unsigned int index_row = 0; index_row < number_frames; index_row++) {
+			const int32_t *row = table.row (index_column, index_row);
+			// a difference to a frame afar that was not available
+			if (row [0] == -1 && index_column % 2 == PREVIOUS) {
+				data.append (-1);
+				continue;
+			}
+			int64_t count = 0;
+			for (unsigned int level = same_colour_level; level < NUMBER_COLOUR_LEVELS; level++)
+				count += row [level];
+			data.append (count);
+		}
+	}
+	return result;
+}
+
+vector<ColumnTable::Column> DifferenceHistograms::pixel_count_difference_columns (unsigned int number_ROIs)
+{
+	vector<ColumnTable::Column> result;
+	for (unsigned int index_ROI = 0; index_ROI < number_ROIs; index_ROI++) {
+		result.push_back (ColumnTable::Column {"ROI" + to_string (index_ROI + 1) + "-background", 1});
+		result.push_back (ColumnTable::Column {"ROI" + to_string (index_ROI + 1) + "-previous", 1});
+	}
+	return result;
+}
+
+vector<ColumnTable::Column> DifferenceHistograms::histogram_columns () const
+{
+	vector<ColumnTable::Column> result = pixel_count_difference_columns (this->number_ROIs);
+	for (ColumnTable::Column &column : result)
+		column.width = NUMBER_COLOUR_LEVELS;
+	return result;
+}
+
+void DifferenceHistograms::write_pixel_count_difference (ColumnTable &table, unsigned int index_row, unsigned int index_frame, unsigned int same_colour_level) const
+{
+	for (unsigned int index_ROI = 0; index_ROI < this->number_ROIs; index_ROI++)
+		for (unsigned int kind = BACKGROUND; kind <= PREVIOUS; kind++)
+			*table.row (2 * index_ROI + kind, index_row) = this->number_different_pixels (index_frame, index_ROI, (Kind) kind, same_colour_level);
+}
+
+void DifferenceHistograms::write_frame (ColumnTable &table, unsigned int index_row, unsigned int index_frame) const
+{
+	for (unsigned int index_ROI = 0; index_ROI < this->number_ROIs; index_ROI++) {
+		for (unsigned int kind = BACKGROUND; kind <= PREVIOUS; kind++) {
+			int32_t *row = table.row (2 * index_ROI + kind, index_row);
+			if (kind == PREVIOUS && !this->previous_available [(index_frame - 1) * this->number_ROIs + index_ROI]) {
+				fill (row, row + NUMBER_COLOUR_LEVELS, -1);
+				continue;
+			}
+			const uint32_t *tail = &this->tail_counts [this->offset (index_frame, index_ROI, kind)];
+			for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+				row [level] = tail [level] - tail [level + 1];
+		}
+	}
+}
+
+bool DifferenceHistograms::read (FILE *file, unsigned int number_frames)
+{
+	Histogram histogram;
+	for (unsigned int index_frame = 1; index_frame <= number_frames; index_frame++) {
+		this->append_frame ();
+		for (unsigned int index_ROI = 0; index_ROI < this->number_ROIs; index_ROI++) {
+			for (unsigned int kind = BACKGROUND; kind <= PREVIOUS; kind++) {
+				int value;
+				if (fscanf (file, (index_ROI > 0 || kind > BACKGROUND) ? ",%d" : "%d", &value) != 1)
+					return false;
+				if (value == -1 && kind == PREVIOUS)
+					continue;
+				histogram [0] = value;
+				for (unsigned int level = 1; level < NUMBER_COLOUR_LEVELS; level++) {
+					if (fscanf (file, ",%d", &value) != 1)
+						return false;
+					histogram [level] = value;
+				}
+				this->set (index_ROI, (Kind) kind, histogram);
+			}
+		}
+	}
+	return true;
+}
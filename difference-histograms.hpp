@@ -0,0 +1,103 @@
+#ifndef __DIFFERENCE_HISTOGRAMS__
+#define __DIFFERENCE_HISTOGRAMS__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <QVector>
+
+#include "column-table.hpp"
+#include "histogram.hpp"
+
+/**
+ * @brief The DifferenceHistograms class stores, for every frame and region of
+ * interest, the histogram of the absolute difference between the frame and the
+ * background image, and between the frame and a frame afar.
+ *
+ * Histograms are kept as cumulative counts from the highest colour level, so
+ * the number of different pixels for any same colour level is a lookup.
+ */
+class DifferenceHistograms
+{
+	const unsigned int number_ROIs;
+	/**
+	 * Number of pixels whose difference is equal or higher than each colour
+	 * level, per frame, region of interest and kind of difference.  Each block
+	 * has one extra level with zero pixels.
+	 */
+	std::vector<uint32_t> tail_counts;
+	/**
+	 * Whether there was a frame afar to compute the difference, per frame and
+	 * region of interest.
+	 */
+	std::vector<bool> previous_available;
+	size_t offset (unsigned int index_frame, unsigned int index_ROI, unsigned int kind) const;
+public:
+	enum Kind {
+		BACKGROUND = 0,
+		PREVIOUS = 1
+	};
+	DifferenceHistograms (unsigned int number_ROIs);
+	unsigned int number_frames () const;
+	/**
+	 * @brief append_frame Add a frame.  The histograms of the new frame are set
+	 * with method set.
+	 */
+	void append_frame ();
+	/**
+	 * @brief set Set the histogram of the last frame.
+	 */
+	void set (unsigned int index_ROI, Kind kind, const Histogram &histogram);
+	void clear ();
+	/**
+	 * @brief number_different_pixels Return the number of pixels whose
+	 * difference is equal or higher than the given same colour level, or -1 if
+	 * there was no frame afar to compute the difference.  Frames start at one.
+	 */
+	int number_different_pixels (unsigned int index_frame, unsigned int index_ROI, Kind kind, unsigned int same_colour_level) const;
+	/**
+	 * @brief pixel_count_difference Return the pixel count difference data for
+	 * the given same colour level, in the same layout as the data computed from
+	 * the video frames.
+	 */
+	std::vector<QVector<double> > *pixel_count_difference (unsigned int same_colour_level) const;
+	/**
+	 * @brief pixel_count_difference Return the pixel count difference data for
+	 * the given same colour level computed from a difference histograms cache
+	 * table.  The histograms are read from the mapped table, so they are not
+	 * copied to memory.
+	 */
+	static std::vector<QVector<double> > *pixel_count_difference (const ColumnTable &table, unsigned int number_ROIs, unsigned int same_colour_level);
+	/**
+	 * @brief pixel_count_difference_columns Return the columns of a pixel
+	 * count difference cache table.  Column 2i has the difference to the
+	 * background image in region of interest i and column 2i+1 has the
+	 * difference to the frame afar.
+	 */
+	static std::vector<ColumnTable::Column> pixel_count_difference_columns (unsigned int number_ROIs);
+	/**
+	 * @brief histogram_columns Return the columns of a difference histograms
+	 * cache table, in the order of the pixel count difference columns.
+	 */
+	std::vector<ColumnTable::Column> histogram_columns () const;
+	/**
+	 * Write the pixel count difference of the given frame for the given same
+	 * colour level to a row of a pixel count difference table.  Rows start at
+	 * zero.
+	 */
+	void write_pixel_count_difference (ColumnTable &table, unsigned int index_row, unsigned int index_frame, unsigned int same_colour_level) const;
+	/**
+	 * Write the histograms of the given frame to a row of a difference
+	 * histograms table.
+	 */
+	void write_frame (ColumnTable &table, unsigned int index_row, unsigned int index_frame) const;
+	/**
+	 * Read the given number of frames from a comma separated values file.
+	 *
+	 * @return false if the file does not have enough data.
+	 */
+	bool read (FILE *file, unsigned int number_frames);
+};
+
+#endif
@@ -2,33 +2,34 @@
 
 #include "image.hpp"
 #include "process-image.hpp"
+#include "feature-engine.hpp"
 
 using namespace std;
 
 static vector<cv::Mat> read_masks (const RunParameters &parameters);
+static vector<QVector<double> > *read_difference_histograms_pixel_count_difference (const UserParameters &parameters, const string &filename);
+static void delete_pixel_count_difference_raw_delta_frames (map<unsigned int, vector<QVector<double> > *> *data);
 
-Experiment::Experiment (UserParameters &parameters):
+Experiment::Experiment (UserParameters &parameters, bool compute_data):
 	parameters (parameters),
    background (read_background (parameters)),
    masks (read_masks (parameters)),
+   regions (masks),
 	histogram_background_raw (compute_histogram_background (parameters)),
-	histogram_frames_all_raw (compute_histogram_frames_all (parameters)),
+	histogram_frames_all_raw (NULL),
    histogram_frames_rect_raw (NULL),
    histogram_frames_light_calibrated_most_common_colour_method_PLSM (NULL),
    histogram_frames_light_calibrated_most_common_colour_method_LC (NULL),
-   pixel_count_difference_raw (compute_pixel_count_difference_raw (*this)),
-   pixel_count_difference_histogram_equalisation (compute_pixel_count_difference_histogram_equalization (*this)),
+   pixel_count_difference_raw (NULL),
+   pixel_count_difference_histogram_equalisation (NULL),
    pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (NULL),
    pixel_count_difference_light_calibrated_most_common_colour_method_LC (NULL),
+   pixel_count_difference_raw_delta_frames (NULL),
    highest_colour_level_frames_rect (NULL),
-   X_FRAMES (parameters.number_frames),
    X_FIRST_LAST_FRAMES (2)
 {
-	for (unsigned int i = 1; i <= parameters.number_frames; i++) {
-		X_FRAMES [i - 1] = i;
-	}
-	X_FIRST_LAST_FRAMES [0] = 1;
-	X_FIRST_LAST_FRAMES [1] = parameters.number_frames;
+	if (compute_data)
+		this->compute_frame_data ();
 }
 
 Experiment::~Experiment ()
@@ -42,31 +43,142 @@ Experiment::~Experiment ()
 	delete pixel_count_difference_histogram_equalisation;
 	delete pixel_count_difference_light_calibrated_most_common_colour_method_PLSM;
 	delete pixel_count_difference_light_calibrated_most_common_colour_method_LC;
+	delete_pixel_count_difference_raw_delta_frames (pixel_count_difference_raw_delta_frames);
 	delete highest_colour_level_frames_rect;
 }
 
+bool Experiment::update_frames ()
+{
+	if (!this->parameters.update_frames ())
+		return false;
+	fprintf (stderr, "There are %d video frames now\n", this->parameters.number_frames);
+	delete this->histogram_frames_all_raw;
+	delete this->pixel_count_difference_raw;
+	delete this->pixel_count_difference_histogram_equalisation;
+	delete_pixel_count_difference_raw_delta_frames (this->pixel_count_difference_raw_delta_frames);
+	this->compute_frame_data ();
+	// light calibrated data is only available after the rectangle is set
+	if (this->highest_colour_level_frames_rect != NULL)
+		this->set_rect_data (this->parameters.x1, this->parameters.y1, this->parameters.x2, this->parameters.y2);
+	return true;
+}
+
+/**
+ * Compute the data of the video frames that does not depend on the
+ * rectangle.
+ */
+void Experiment::compute_frame_data ()
+{
+	this->X_FRAMES.resize (this->parameters.number_frames);
+	for (unsigned int i = 1; i <= this->parameters.number_frames; i++) {
+		this->X_FRAMES [i - 1] = i;
+	}
+	this->X_FIRST_LAST_FRAMES [0] = 1;
+	this->X_FIRST_LAST_FRAMES [1] = this->parameters.number_frames;
+	FeatureEngine engine (this->parameters);
+	this->histogram_frames_all_raw = compute_histogram_frames_all (this->parameters, &engine);
+	this->pixel_count_difference_raw = compute_pixel_count_difference_raw (*this, &engine);
+	this->pixel_count_difference_histogram_equalisation = compute_pixel_count_difference_histogram_equalization (*this, &engine);
+	this->pixel_count_difference_raw_delta_frames = compute_pixel_count_difference_raw_delta_frames (*this, &engine);
+	engine.run ();
+}
+
 void Experiment::set_rect_data (int x1, int y1, int x2, int y2)
 {
 	this->parameters.x1 = x1;
 	this->parameters.y1 = y1;
 	this->parameters.x2 = x2;
 	this->parameters.y2 = y2;
+	FeatureEngine engine (this->parameters);
 	delete this->histogram_frames_rect_raw;
-	this->histogram_frames_rect_raw = compute_histogram_frames_rect (this->parameters);
+	this->histogram_frames_rect_raw = compute_histogram_frames_rect (this->parameters, &engine);
 	delete this->highest_colour_level_frames_rect;
-	this->highest_colour_level_frames_rect = compute_highest_colour_level_frames_rect (this->parameters);
+	this->highest_colour_level_frames_rect = compute_highest_colour_level_frames_rect (this->parameters, &engine);
 	delete this->histogram_frames_light_calibrated_most_common_colour_method_PLSM;
 	this->histogram_frames_light_calibrated_most_common_colour_method_PLSM =
-	      compute_histogram_frames_light_calibrated_most_common_colour_method_PLSM (*this);
+	      compute_histogram_frames_light_calibrated_most_common_colour_method_PLSM (*this, &engine);
 	delete this->histogram_frames_light_calibrated_most_common_colour_method_LC;
 	this->histogram_frames_light_calibrated_most_common_colour_method_LC =
-	      compute_histogram_frames_light_calibrated_most_common_colour_method_LC (*this);
+	      compute_histogram_frames_light_calibrated_most_common_colour_method_LC (*this, &engine);
+	// the light calibrated pixel count difference uses the most common colour
+	// computed by a previously scheduled feature for the same frame
 	delete this->pixel_count_difference_light_calibrated_most_common_colour_method_PLSM;
 	this->pixel_count_difference_light_calibrated_most_common_colour_method_PLSM =
-	      compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (*this);
+	      compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (*this, &engine);
 	delete this->pixel_count_difference_light_calibrated_most_common_colour_method_LC;
 	this->pixel_count_difference_light_calibrated_most_common_colour_method_LC =
-	      compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (*this);
+	      compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (*this, &engine);
+	engine.run ();
+}
+
+void Experiment::update_same_colour_data (unsigned int same_colour_threshold)
+{
+	this->parameters.set_same_colour_threshold (same_colour_threshold);
+	typedef vector<QVector<double> > *(*compute_function) (const Experiment &, FeatureEngine *);
+	struct PCD_Info {
+		vector<QVector<double> > **data;
+		string histograms_filename;
+		compute_function compute;
+	};
+	PCD_Info pcd_info[] = {
+	   {&this->pixel_count_difference_raw,
+	    this->parameters.difference_histograms_raw_filename (), compute_pixel_count_difference_raw},
+	   {&this->pixel_count_difference_histogram_equalisation,
+	    this->parameters.difference_histograms_histogram_equalization_filename (), compute_pixel_count_difference_histogram_equalization},
+	   {&this->pixel_count_difference_light_calibrated_most_common_colour_method_PLSM,
+	    this->parameters.difference_histograms_light_calibrated_most_common_colour_filename_method_PLSM (), compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM},
+	   {&this->pixel_count_difference_light_calibrated_most_common_colour_method_LC,
+	    this->parameters.difference_histograms_light_calibrated_most_common_colour_filename_method_LC (), compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC},
+	};
+	// light calibrated data is only available after the rectangle is set
+	unsigned int number_pcd = this->highest_colour_level_frames_rect != NULL ? 4 : 2;
+	FeatureEngine engine (this->parameters);
+	for (unsigned int i = 0; i < number_pcd; i++) {
+		PCD_Info &info = pcd_info [i];
+		delete *info.data;
+		*info.data = read_difference_histograms_pixel_count_difference (this->parameters, info.histograms_filename);
+		if (*info.data == NULL)
+			*info.data = info.compute (*this, &engine);
+	}
+	// the extra frame gaps are recomputed together if any lacks its histograms
+	delete_pixel_count_difference_raw_delta_frames (this->pixel_count_difference_raw_delta_frames);
+	this->pixel_count_difference_raw_delta_frames = new map<unsigned int, vector<QVector<double> > *> ();
+	for (unsigned int delta_frame : this->parameters.extra_delta_frames) {
+		vector<QVector<double> > *data = read_difference_histograms_pixel_count_difference (this->parameters, this->parameters.difference_histograms_raw_filename (delta_frame));
+		if (data == NULL) {
+			delete_pixel_count_difference_raw_delta_frames (this->pixel_count_difference_raw_delta_frames);
+			this->pixel_count_difference_raw_delta_frames = compute_pixel_count_difference_raw_delta_frames (*this, &engine);
+			break;
+		}
+		(*this->pixel_count_difference_raw_delta_frames) [delta_frame] = data;
+	}
+	engine.run ();
+}
+
+vector<string> Experiment::cache_filenames (const UserParameters &parameters)
+{
+	vector<string> result = {
+	   parameters.histogram_frames_all_filename (),
+	   parameters.features_pixel_count_difference_raw_filename (),
+	   parameters.difference_histograms_raw_filename (),
+	   parameters.features_pixel_count_difference_histogram_equalization_filename (),
+	   parameters.difference_histograms_histogram_equalization_filename (),
+	};
+	for (unsigned int delta_frame : parameters.extra_delta_frames) {
+		result.push_back (parameters.features_pixel_count_difference_raw_filename (delta_frame));
+		result.push_back (parameters.difference_histograms_raw_filename (delta_frame));
+	}
+	if (parameters.has_rectangle ()) {
+		result.push_back (parameters.histogram_frames_rect ());
+		result.push_back (parameters.highest_colour_level_frames_rect_filename ());
+		result.push_back (parameters.histogram_frames_light_calibrated_most_common_colour_method_PLSM_filename ());
+		result.push_back (parameters.histogram_frames_light_calibrated_most_common_colour_method_LC_filename ());
+		result.push_back (parameters.features_pixel_count_difference_light_calibrated_most_common_colour_filename_method_PLSM ());
+		result.push_back (parameters.difference_histograms_light_calibrated_most_common_colour_filename_method_PLSM ());
+		result.push_back (parameters.features_pixel_count_difference_light_calibrated_most_common_colour_filename_method_LC ());
+		result.push_back (parameters.difference_histograms_light_calibrated_most_common_colour_filename_method_LC ());
+	}
+	return result;
 }
 
 vector<cv::Mat> read_masks (const RunParameters &parameters)
@@ -77,3 +189,42 @@ vector<cv::Mat> read_masks (const RunParameters &parameters)
 	}
 	return result;
 }
+
+/**
+ * Compute the pixel count difference with the current same colour threshold
+ * from a difference histograms cache table, or from its legacy comma separated
+ * values file.  Return NULL if neither has the histograms of all frames.
+ */
+vector<QVector<double> > *read_difference_histograms_pixel_count_difference (const UserParameters &parameters, const string &filename)
+{
+	ColumnTable *table = open_cache_table (parameters, filename, DifferenceHistograms (parameters.number_ROIs).histogram_columns ());
+	if (table != NULL) {
+		fprintf (stderr, "Computing pixel count difference with same colour threshold %d from the histograms in %s\n", parameters.get_same_colour_threshold (), filename.c_str ());
+		vector<QVector<double> > *result = DifferenceHistograms::pixel_count_difference (*table, parameters.number_ROIs, parameters.get_same_colour_level ());
+		delete table;
+		return result;
+	}
+	string legacy_filename = legacy_csv_filename (filename);
+	FILE *file = fopen (legacy_filename.c_str (), "r");
+	if (file == NULL)
+		return NULL;
+	fprintf (stderr, "Reading difference histograms from file %s\n", legacy_filename.c_str ());
+	// legacy files are parsed to memory for the update only
+	DifferenceHistograms histograms (parameters.number_ROIs);
+	vector<QVector<double> > *result = NULL;
+	if (histograms.read (file, parameters.number_frames))
+		result = histograms.pixel_count_difference (parameters.get_same_colour_level ());
+	else
+		fprintf (stderr, "  file %s is incomplete, ignoring it\n", legacy_filename.c_str ());
+	fclose (file);
+	return result;
+}
+
+void delete_pixel_count_difference_raw_delta_frames (map<unsigned int, vector<QVector<double> > *> *data)
+{
+	if (data == NULL)
+		return ;
+	for (auto &item : *data)
+		delete item.second;
+	delete data;
+}
@@ -9,12 +9,19 @@
 #include "parameters.hpp"
 #include "process-image.hpp"
 #include "image.hpp"
+#include "difference-histograms.hpp"
+#include "region-map.hpp"
 
 class Experiment {
 public:
 	UserParameters &parameters;
 	cv::Mat background;
 	std::vector<cv::Mat> masks;
+	/**
+	 * The masks compiled to spans of pixels, used to compute the statistics of
+	 * each region of interest.
+	 */
+	RegionMap regions;
 	/**
 	 * Cache with the histogram of the background image.
 	 */
@@ -22,13 +29,13 @@ public:
 	/**
 	 * Cache with the histogram of all frames.
 	 */
-	std::map<int, Histogram> *histogram_frames_all_raw;
+	HistogramMatrix *histogram_frames_all_raw;
 	/**
 	 * Caches the histogram of a rectangular area for all frames.
 	 */
-	std::map<int, Histogram> *histogram_frames_rect_raw;
-	std::map<int, Histogram> *histogram_frames_light_calibrated_most_common_colour_method_PLSM;
-	std::map<int, Histogram> *histogram_frames_light_calibrated_most_common_colour_method_LC;
+	HistogramMatrix *histogram_frames_rect_raw;
+	HistogramMatrix *histogram_frames_light_calibrated_most_common_colour_method_PLSM;
+	HistogramMatrix *histogram_frames_light_calibrated_most_common_colour_method_LC;
 	/**
 	 * Cache with the pixel count difference raw between background image and
 	 * raw frame and between raw frames x seconds apart, for all regions of interest.
@@ -56,6 +63,11 @@ public:
 	 */
 	std::vector<QVector<double> > *pixel_count_difference_light_calibrated_most_common_colour_method_PLSM;
 	std::vector<QVector<double> > *pixel_count_difference_light_calibrated_most_common_colour_method_LC;
+	/**
+	 * @brief Pixel count difference on raw frames for each extra frame gap
+	 * given in the user parameters.
+	 */
+	std::map<unsigned int, std::vector<QVector<double> > *> *pixel_count_difference_raw_delta_frames;
 	/**
 	 * Cached highest colour level in frame histogram.
 	 */
@@ -65,10 +77,36 @@ public:
 
 	QVector<double> X_FIRST_LAST_FRAMES;
 
-	Experiment (UserParameters &parameters);
+	/**
+	 * @brief Experiment Read the background image and the masks and, if
+	 * requested, compute the data of the video frames that does not depend on
+	 * the rectangle.
+	 */
+	Experiment (UserParameters &parameters, bool compute_data = true);
 	virtual ~Experiment ();
+	/**
+	 * @brief update_frames Pick up the frames added to the folder and extend
+	 * the data with them.  Only the new frames are processed.
+	 * @return true if there are new frames.
+	 */
+	bool update_frames ();
 
 	void set_rect_data (int x1, int y1, int x2, int y2);
+	/**
+	 * @brief update_same_colour_data Set the same colour threshold and update
+	 * the pixel count difference data.  Data is computed from the difference
+	 * histograms cache tables if they are available, otherwise video frames
+	 * are processed.  The tables are mapped for the update only, so the
+	 * histograms of the differences are never kept in memory.
+	 */
+	void update_same_colour_data (unsigned int same_colour_threshold);
+	/**
+	 * @brief cache_filenames Return the cache tables written when the frame
+	 * data and, if the rectangle is set, the rectangle data are computed.
+	 */
+	static std::vector<std::string> cache_filenames (const UserParameters &parameters);
+private:
+	void compute_frame_data ();
 };
 
 #endif
@@ -0,0 +1,333 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+#include "feature-engine.hpp"
+#include "frame-pool.hpp"
+#include "frame-prefetcher.hpp"
+#include "image.hpp"
+
+using namespace std;
+
+/**
+ * Return a temporary name for a cache file that no other process or thread
+ * uses.
+ */
+static string unique_temporary_filename (const string &filename)
+{
+	static atomic<unsigned int> counter (0);
+	return filename + ".partial." + to_string (getpid ()) + "." + to_string (counter++);
+}
+
+CacheFile::CacheFile (const string &filename, bool resumable):
+	filename (filename),
+	resumable (resumable),
+	temporary_filename (resumable ? filename + ".partial" : unique_temporary_filename (filename)),
+	file (NULL)
+{
+	if (resumable) {
+		this->file = fopen (this->temporary_filename.c_str (), "r+");
+		if (this->file == NULL)
+			this->file = fopen (this->temporary_filename.c_str (), "w+");
+	}
+	else {
+		int descriptor = open (this->temporary_filename.c_str (), O_RDWR | O_CREAT | O_EXCL, 0644);
+		// left by a process that had the same identifier and was killed
+		if (descriptor == -1 && errno == EEXIST && unlink (this->temporary_filename.c_str ()) == 0)
+			descriptor = open (this->temporary_filename.c_str (), O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (descriptor != -1 && (this->file = fdopen (descriptor, "w+")) == NULL)
+			close (descriptor);
+	}
+	if (this->file == NULL) {
+		fprintf (stderr, "Could not create cache file %s!\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+}
+
+CacheFile::~CacheFile ()
+{
+	if (this->file != NULL) {
+		fclose (this->file);
+		if (!this->resumable)
+			unlink (this->temporary_filename.c_str ());
+	}
+}
+
+void CacheFile::commit ()
+{
+	// the contents must be on disk before the cache file name refers to them
+	fflush (this->file);
+	fsync (fileno (this->file));
+	fclose (this->file);
+	this->file = NULL;
+	rename (this->temporary_filename.c_str (), this->filename.c_str ());
+}
+
+/**
+ * Resume the table left in the temporary file by an interrupted run or, if
+ * there is none with the same signature, create a new table.  A new table
+ * starts with the rows of a cache file computed from fewer frames.
+ */
+static ColumnTable *resume_or_create (FILE *file, const RunParameters &parameters, const string &filename, const vector<ColumnTable::Column> &columns)
+{
+	ColumnTable::Signature signature = parameters.cache_signature (filename);
+	ColumnTable *result = ColumnTable::resume (file, parameters.number_frames, columns, signature);
+	if (result != NULL) {
+		if (result->number_complete_rows () > 0)
+			fprintf (stderr, "  resuming %s after frame %u\n", filename.c_str (), result->number_complete_rows ());
+		return result;
+	}
+	result = ColumnTable::create (file, parameters.number_frames, columns, signature);
+	ColumnTable *previous = ColumnTable::open (filename);
+	if (previous != NULL
+	    && previous->complete ()
+	    && previous->number_rows () < parameters.number_frames
+	    && previous->matches (previous->number_rows (), columns)
+	    && previous->signature () == parameters.cache_signature (filename, previous->number_rows ())) {
+		fprintf (stderr, "  extending %s from %u to %u frames\n", filename.c_str (), previous->number_rows (), parameters.number_frames);
+		result->copy_rows (*previous, 0, previous->number_rows ());
+		result->checkpoint (previous->number_rows ());
+	}
+	delete previous;
+	return result;
+}
+
+CacheTable::CacheTable (const RunParameters &parameters, const string &filename, const vector<ColumnTable::Column> &columns):
+	file (parameters.shard_filename (filename), true),
+	table (resume_or_create (file.get (), parameters, filename, columns)),
+	shard_first_frame (parameters.shard_first_frame ()),
+	shard_last_frame (parameters.shard_last_frame ())
+{
+}
+
+CacheTable::~CacheTable ()
+{
+	delete this->table;
+}
+
+void CacheTable::commit ()
+{
+	this->table->checkpoint (this->shard_last_frame);
+	delete this->table;
+	this->table = NULL;
+	this->file.commit ();
+}
+
+ColumnTable *open_cache_table (const RunParameters &parameters, const string &filename, const vector<ColumnTable::Column> &columns)
+{
+	ColumnTable *result = ColumnTable::open (filename);
+	if (result == NULL)
+		return NULL;
+	if (result->number_rows () < parameters.number_frames && result->matches (result->number_rows (), columns)) {
+		fprintf (stderr, "  table %s has data for %u frames, computing the new frames\n", filename.c_str (), result->number_rows ());
+		delete result;
+		return NULL;
+	}
+	if (!result->matches (parameters.number_frames, columns) || !result->complete ()) {
+		fprintf (stderr, "  table %s does not match the video frames, ignoring it\n", filename.c_str ());
+		delete result;
+		return NULL;
+	}
+	if (!(result->signature () == parameters.cache_signature (filename))) {
+		fprintf (stderr, "  table %s was computed from other video frames or masks, ignoring it\n", filename.c_str ());
+		delete result;
+		return NULL;
+	}
+	fprintf (stderr, "  reading data from file %s\n", filename.c_str ());
+	return result;
+}
+
+bool valid_cache_table (const RunParameters &parameters, const string &filename)
+{
+	ColumnTable *table = ColumnTable::open (filename);
+	bool result =
+	      table != NULL
+	      && table->complete ()
+	      && table->number_rows () == parameters.number_frames
+	      && table->signature () == parameters.cache_signature (filename);
+	delete table;
+	return result;
+}
+
+bool merge_cache_table_shards (const RunParameters &parameters, const string &filename)
+{
+	struct Shard {
+		unsigned int first;
+		unsigned int last;
+		string filename;
+	};
+	vector<Shard> shards;
+	string folder = filename.substr (0, filename.rfind ('/') + 1);
+	string prefix = filename.substr (folder.size ()) + SHARD_FILENAME_INFIX;
+	DIR *directory = opendir (folder.empty () ? "." : folder.c_str ());
+	if (directory == NULL)
+		return false;
+	struct dirent *entry;
+	while ((entry = readdir (directory)) != NULL) {
+		Shard shard;
+		char rest;
+		if (strncmp (entry->d_name, prefix.c_str (), prefix.size ()) == 0
+		    && sscanf (entry->d_name + prefix.size (), "%u-%u%c", &shard.first, &shard.last, &rest) == 2) {
+			shard.filename = folder + entry->d_name;
+			shards.push_back (shard);
+		}
+	}
+	closedir (directory);
+	if (shards.empty ())
+		return false;
+	sort (shards.begin (), shards.end (), [] (const Shard &a, const Shard &b) {
+		return a.first < b.first || (a.first == b.first && a.last > b.last);
+	});
+	// the merged table is written as a single run would write it
+	ColumnTable::Signature signature = parameters.cache_signature (filename);
+	CacheFile file (filename);
+	ColumnTable *result = NULL;
+	vector<ColumnTable::Column> columns;
+	unsigned int number_merged_rows = 0;
+	bool ok = true;
+	for (unsigned int index = 0; ok && index < shards.size (); index++) {
+		const Shard &shard = shards [index];
+		if (shard.last <= number_merged_rows)
+			continue;
+		if (shard.first > number_merged_rows + 1) {
+			fprintf (stderr, "  shards of %s do not have frames %u to %u\n", filename.c_str (), number_merged_rows + 1, shard.first - 1);
+			ok = false;
+			break;
+		}
+		ColumnTable *table = ColumnTable::open (shard.filename);
+		if (table != NULL && result == NULL) {
+			for (unsigned int index_column = 0; index_column < table->number_columns (); index_column++)
+				columns.push_back (table->column (index_column));
+			result = ColumnTable::create (file.get (), parameters.number_frames, columns, signature);
+		}
+		ok =
+		      table != NULL
+		      && table->matches (parameters.number_frames, columns)
+		      && table->number_complete_rows () >= shard.last
+		      && table->signature () == signature;
+		if (ok) {
+			result->copy_rows (*table, number_merged_rows, shard.last - number_merged_rows);
+			number_merged_rows = shard.last;
+		}
+		else
+			fprintf (stderr, "  shard %s is incomplete or was computed from other video frames or masks\n", shard.filename.c_str ());
+		delete table;
+	}
+	if (ok && number_merged_rows < parameters.number_frames) {
+		fprintf (stderr, "  shards of %s do not have frames %u to %u\n", filename.c_str (), number_merged_rows + 1, parameters.number_frames);
+		ok = false;
+	}
+	if (!ok) {
+		delete result;
+		return false;
+	}
+	result->checkpoint (parameters.number_frames);
+	delete result;
+	file.commit ();
+	for (const Shard &shard : shards)
+		unlink (shard.filename.c_str ());
+	fprintf (stderr, "  merged %d shards into %s\n", (int) shards.size (), filename.c_str ());
+	return true;
+}
+
+CachedFrameFeature::CachedFrameFeature (const string &filename, const RunParameters &parameters, const vector<ColumnTable::Column> &columns):
+	cache_table (parameters, filename, columns),
+	table (cache_table.get ()),
+	first (cache_table.number_complete_rows () + 1)
+{
+}
+
+unsigned int CachedFrameFeature::first_frame () const
+{
+	return this->first;
+}
+
+void CachedFrameFeature::checkpoint (unsigned int index_frame)
+{
+	this->cache_table.checkpoint (index_frame);
+}
+
+void CachedFrameFeature::finish ()
+{
+	this->cache_table.commit ();
+}
+
+FeatureEngine::FeatureEngine (const RunParameters &parameters):
+	parameters (parameters)
+{
+}
+
+FeatureEngine::~FeatureEngine ()
+{
+	for (FrameFeature *feature : this->features)
+		delete feature;
+}
+
+void FeatureEngine::add (FrameFeature *feature)
+{
+	this->features.push_back (feature);
+}
+
+void FeatureEngine::defer (const function<void ()> &job)
+{
+	this->deferred_jobs.push_back (job);
+}
+
+bool FeatureEngine::empty () const
+{
+	return this->features.empty () && this->deferred_jobs.empty ();
+}
+
+void FeatureEngine::run ()
+{
+	if (!this->features.empty ())
+		this->run_features ();
+	for (function<void ()> &job : this->deferred_jobs)
+		job ();
+	this->deferred_jobs.clear ();
+	// the buffers of this pass are not kept for the life of the process
+	FramePool::instance ().report (stderr);
+	FramePool::instance ().trim ();
+}
+
+void FeatureEngine::run_features ()
+{
+	fprintf (stderr, "Processing video frames in folder %s for %d feature(s)...\n", this->parameters.folder.c_str (), (int) this->features.size ());
+	// features resumed from an interrupted run start at their first frame
+	// minus the frames they need before it
+	vector<unsigned int> firsts, starts;
+	unsigned int first = this->parameters.number_frames + 1;
+	for (FrameFeature *feature : this->features) {
+		firsts.push_back (feature->first_frame ());
+		starts.push_back (firsts.back () > feature->history () ? firsts.back () - feature->history () : 1);
+		first = min (first, starts.back ());
+	}
+	unsigned int last = this->parameters.shard_last_frame ();
+	if (this->parameters.sharded ())
+		fprintf (stderr, "  processing the shard of frames %u to %u\n", this->parameters.shard_first_frame (), last);
+	else if (first > 1)
+		fprintf (stderr, "  resuming from frame %u\n", first);
+	// frames are decoded ahead by other threads, unless the frame source is
+	// sequential, while the features process them in order
+	FramePrefetcher prefetcher (this->parameters.frame_source (), first, last, this->parameters.readahead_depth, this->parameters.number_threads);
+	this->parameters.fold_frames (first, last, [&] (unsigned int index_frame) {
+		cv::Mat frame = prefetcher.next ();
+		for (unsigned int index = 0; index < this->features.size (); index++)
+			if (index_frame >= starts [index]) {
+				this->features [index]->process (index_frame, frame);
+				if (index_frame >= firsts [index] && index_frame % this->parameters.checkpoint_interval == 0)
+					this->features [index]->checkpoint (index_frame);
+			}
+		if (index_frame % this->parameters.checkpoint_interval == 0)
+			fprintf (stderr, "  processed %u of %u frames\n", index_frame, this->parameters.number_frames);
+	});
+	for (FrameFeature *feature : this->features) {
+		feature->finish ();
+		delete feature;
+	}
+	this->features.clear ();
+}
@@ -0,0 +1,230 @@
+#ifndef __FEATURE_ENGINE__
+#define __FEATURE_ENGINE__
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "column-table.hpp"
+#include "parameters.hpp"
+
+/**
+ * @brief The FrameFeature class represents a feature that is extracted from
+ * every video frame.
+ *
+ * Features are run by a FeatureEngine which decodes each frame only once and
+ * presents it to all registered features.
+ */
+class FrameFeature
+{
+public:
+	virtual ~FrameFeature () {}
+	/**
+	 * @brief process Extract this feature from the given frame.  Frames are
+	 * presented in increasing index order.  The frame is shared by all features
+	 * and must not be modified.
+	 */
+	virtual void process (unsigned int index_frame, const cv::Mat &frame) = 0;
+	/**
+	 * @brief first_frame Return the first frame whose data this feature has to
+	 * compute.  Data of the frames before it was recovered from the cache of
+	 * an interrupted run.
+	 */
+	virtual unsigned int first_frame () const
+	{
+		return 1;
+	}
+	/**
+	 * @brief history Return the number of frames before the first frame that
+	 * this feature must be presented to compute the first frame.  Frames
+	 * before the first frame must not produce data.
+	 */
+	virtual unsigned int history () const
+	{
+		return 0;
+	}
+	/**
+	 * @brief checkpoint Called when all frames up to the given one have been
+	 * processed.  The data computed so far should be made durable.
+	 */
+	virtual void checkpoint (unsigned int) {}
+	/**
+	 * @brief finish Called after all frames have been processed.
+	 */
+	virtual void finish () {}
+};
+
+/**
+ * @brief The CacheFile class is a cache file that is written under a
+ * temporary name and renamed when it is complete.  This way other compute
+ * functions do not mistake a cache that is being written for a complete one.
+ *
+ * The temporary name of a cache that is not resumable is unique to the
+ * process, so that processes that write the same cache at the same time,
+ * such as the runs of the shards of a folder, do not write to the same file.
+ */
+class CacheFile
+{
+	const std::string filename;
+	const bool resumable;
+	const std::string temporary_filename;
+	FILE *file;
+public:
+	/**
+	 * @brief CacheFile Create the temporary file, open for reading and
+	 * writing.  If the cache is resumable, the temporary file left by a
+	 * previous run is opened instead and kept if the cache is not committed.
+	 */
+	CacheFile (const std::string &filename, bool resumable = false);
+	/**
+	 * Removes the temporary file if the cache was not committed and is not
+	 * resumable.
+	 */
+	~CacheFile ();
+	FILE *get () const
+	{
+		return this->file;
+	}
+	/**
+	 * @brief commit Flush the file to disk, close it and rename it to the
+	 * cache file name.
+	 */
+	void commit ();
+};
+
+/**
+ * @brief The CacheTable class is a cache file with a column table, with one
+ * row per video frame, that is written under a temporary name and renamed when
+ * it is complete.
+ *
+ * Rows are written in order and checkpointed from time to time.  If a run is
+ * interrupted, the temporary file is kept and the next run with the same
+ * signature resumes after its last checkpointed row.  If frames were added
+ * to the folder since the cache file was written, the new table starts with
+ * the rows of the cache file and only the new frames are computed.
+ *
+ * A run that processes a shard of the video frames writes the table to the
+ * shard file.  Its rows before the shard are considered complete and are left
+ * empty.
+ */
+class CacheTable
+{
+	CacheFile file;
+	ColumnTable *table;
+	const unsigned int shard_first_frame;
+	const unsigned int shard_last_frame;
+public:
+	CacheTable (const RunParameters &parameters, const std::string &filename, const std::vector<ColumnTable::Column> &columns);
+	~CacheTable ();
+	ColumnTable &get ()
+	{
+		return *this->table;
+	}
+	/**
+	 * Return the number of rows recovered from an interrupted run.
+	 */
+	unsigned int number_complete_rows () const
+	{
+		return std::max (this->table->number_complete_rows (), this->shard_first_frame - 1);
+	}
+	/**
+	 * @brief checkpoint Flush the table to disk and record that the rows of
+	 * the frames up to the given one are complete.
+	 */
+	void checkpoint (unsigned int index_frame)
+	{
+		this->table->checkpoint (index_frame);
+	}
+	/**
+	 * @brief commit Mark all rows, up to the end of the shard, complete, unmap
+	 * the table and rename the file to the cache file name.
+	 */
+	void commit ();
+};
+
+/**
+ * Open a cache table and check that it is complete, that it has one row per
+ * video frame and the given columns, and that it was computed from the current
+ * video frames and parameters.
+ *
+ * @return NULL if the cache table does not exist or does not match.
+ */
+ColumnTable *open_cache_table (const RunParameters &parameters, const std::string &filename, const std::vector<ColumnTable::Column> &columns);
+
+/**
+ * Return whether a cache table is complete, has one row per video frame and
+ * was computed from the current video frames and parameters.
+ */
+bool valid_cache_table (const RunParameters &parameters, const std::string &filename);
+
+/**
+ * Merge the shard files of a cache table, written by runs that processed
+ * shards of the video frames, into the cache table and remove them.  The
+ * shards must cover all video frames and be complete.
+ *
+ * @return false if there are no shard files or they can not be merged.
+ */
+bool merge_cache_table_shards (const RunParameters &parameters, const std::string &filename);
+
+/**
+ * @brief The CachedFrameFeature class is a feature whose values are written,
+ * one row per frame, to a cache table.  If the table is resumed, the feature
+ * starts after its complete rows, which subclasses read back in memory.
+ */
+class CachedFrameFeature:
+	public FrameFeature
+{
+	CacheTable cache_table;
+protected:
+	ColumnTable &table;
+	/**
+	 * First frame whose row is not complete when the feature is created.
+	 */
+	unsigned int first;
+public:
+	CachedFrameFeature (const std::string &filename, const RunParameters &parameters, const std::vector<ColumnTable::Column> &columns);
+	virtual unsigned int first_frame () const;
+	virtual void checkpoint (unsigned int index_frame);
+	virtual void finish ();
+};
+
+/**
+ * @brief The FeatureEngine class performs a single pass over all the video
+ * frames and runs all registered features on each decoded frame.
+ */
+class FeatureEngine
+{
+	const RunParameters &parameters;
+	std::vector<FrameFeature *> features;
+	std::vector<std::function<void ()> > deferred_jobs;
+	void run_features ();
+public:
+	FeatureEngine (const RunParameters &parameters);
+	/**
+	 * Deletes all the registered features, which closes their cache files.
+	 */
+	~FeatureEngine ();
+	/**
+	 * @brief add Register a feature.  The engine takes ownership of the
+	 * feature.  Features are run in the order they were registered, so a
+	 * feature may use data that a previously registered feature has computed
+	 * for the same frame.
+	 */
+	void add (FrameFeature *feature);
+	/**
+	 * @brief defer Register a job that runs after the pass over the video
+	 * frames.  Jobs can use the data computed by the features.
+	 */
+	void defer (const std::function<void ()> &job);
+	bool empty () const;
+	/**
+	 * @brief run Decode every video frame once and run all registered features
+	 * on it.  Then run the deferred jobs.
+	 */
+	void run ();
+};
+
+#endif
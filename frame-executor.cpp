@@ -0,0 +1,175 @@
+#include <condition_variable>
+#include <map>
+#include <thread>
+
+#include "frame-executor.hpp"
+
+using namespace std;
+
+WorkStealingRanges::WorkStealingRanges (unsigned int begin, unsigned int end, unsigned int number_workers):
+	slices (number_workers)
+{
+	unsigned int length = end - begin;
+	for (unsigned int worker = 0; worker < number_workers; worker++) {
+		this->slices [worker].begin = begin + (unsigned int) ((unsigned long) length * worker / number_workers);
+		this->slices [worker].end = begin + (unsigned int) ((unsigned long) length * (worker + 1) / number_workers);
+	}
+}
+
+bool WorkStealingRanges::next (unsigned int worker, unsigned int &index)
+{
+	do {
+		Slice &own = this->slices [worker];
+		{
+			lock_guard<mutex> lock (own.mutex);
+			if (own.begin < own.end) {
+				index = own.begin++;
+				return true;
+			}
+		}
+	} while (this->steal (worker));
+	return false;
+}
+
+bool WorkStealingRanges::steal (unsigned int worker)
+{
+	for (;;) {
+		// pick the victim with the largest remaining slice
+		unsigned int victim = worker;
+		unsigned int largest = 0;
+		for (unsigned int other = 0; other < this->slices.size (); other++) {
+			if (other == worker)
+				continue;
+			lock_guard<mutex> lock (this->slices [other].mutex);
+			unsigned int remaining = this->slices [other].end - this->slices [other].begin;
+			if (remaining > largest) {
+				largest = remaining;
+				victim = other;
+			}
+		}
+		if (largest == 0)
+			return false;
+		Slice &thief = this->slices [worker];
+		Slice &target = this->slices [victim];
+		// lock both slices in a fixed order
+		unique_lock<mutex> lock1 (this->slices [min (worker, victim)].mutex);
+		unique_lock<mutex> lock2 (this->slices [max (worker, victim)].mutex);
+		unsigned int remaining = target.end - target.begin;
+		if (remaining == 0)
+			continue;
+		unsigned int half = (remaining + 1) / 2;
+		thief.end = target.end;
+		thief.begin = target.end - half;
+		target.end = thief.begin;
+		return true;
+	}
+}
+
+class WorkerPool::Implementation
+{
+public:
+	vector<thread> threads;
+	mutex job_mutex;
+	mutex state_mutex;
+	condition_variable start_condition;
+	condition_variable done_condition;
+	const function<void (unsigned int)> *job;
+	unsigned long generation;
+	unsigned int pending;
+	bool stop;
+	Implementation (unsigned int number_workers):
+		job (NULL),
+		generation (0),
+		pending (0),
+		stop (false)
+	{
+		for (unsigned int worker = 1; worker < number_workers; worker++)
+			this->threads.push_back (thread (&Implementation::loop, this, worker));
+	}
+	~Implementation ()
+	{
+		{
+			lock_guard<mutex> lock (this->state_mutex);
+			this->stop = true;
+		}
+		this->start_condition.notify_all ();
+		for (thread &a_thread : this->threads)
+			a_thread.join ();
+	}
+	void loop (unsigned int worker);
+};
+
+static thread_local bool inside_job = false;
+
+void WorkerPool::Implementation::loop (unsigned int worker)
+{
+	inside_job = true;
+	unsigned long seen_generation = 0;
+	for (;;) {
+		const function<void (unsigned int)> *current_job;
+		{
+			unique_lock<mutex> lock (this->state_mutex);
+			this->start_condition.wait (lock, [&] { return this->stop || this->generation != seen_generation; });
+			if (this->stop)
+				return ;
+			seen_generation = this->generation;
+			current_job = this->job;
+		}
+		(*current_job) (worker);
+		{
+			lock_guard<mutex> lock (this->state_mutex);
+			this->pending--;
+		}
+		this->done_condition.notify_one ();
+	}
+}
+
+WorkerPool::WorkerPool (unsigned int number_workers):
+	implementation (new Implementation (number_workers))
+{
+}
+
+WorkerPool::~WorkerPool ()
+{
+	delete this->implementation;
+}
+
+WorkerPool &WorkerPool::instance (unsigned int number_workers)
+{
+	static mutex instance_mutex;
+	// pools are never deleted, as other threads may be running jobs in them
+	static map<unsigned int, WorkerPool *> pools;
+	lock_guard<mutex> lock (instance_mutex);
+	number_workers = max (1u, number_workers);
+	WorkerPool *&pool = pools [number_workers];
+	if (pool == NULL)
+		pool = new WorkerPool (number_workers);
+	return *pool;
+}
+
+unsigned int WorkerPool::size () const
+{
+	return this->implementation->threads.size () + 1;
+}
+
+void WorkerPool::run (const function<void (unsigned int)> &job)
+{
+	// nested or concurrent calls run the job in the calling thread only
+	unique_lock<mutex> job_lock (this->implementation->job_mutex, try_to_lock);
+	if (inside_job || !job_lock.owns_lock ()) {
+		job (0);
+		return ;
+	}
+	{
+		lock_guard<mutex> lock (this->implementation->state_mutex);
+		this->implementation->job = &job;
+		this->implementation->pending = this->implementation->threads.size ();
+		this->implementation->generation++;
+	}
+	this->implementation->start_condition.notify_all ();
+	inside_job = true;
+	job (0);
+	inside_job = false;
+	unique_lock<mutex> lock (this->implementation->state_mutex);
+	this->implementation->done_condition.wait (lock, [&] { return this->implementation->pending == 0; });
+}
@@ -0,0 +1,101 @@
+#ifndef __FRAME_EXECUTOR__
+#define __FRAME_EXECUTOR__
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The WorkStealingRanges class distributes the indexes in a range
+ * among workers.  Each worker starts with a contiguous slice and takes indexes
+ * from its front.  A worker that runs out of indexes steals the back half of
+ * the largest remaining slice.
+ */
+class WorkStealingRanges
+{
+	struct Slice {
+		std::mutex mutex;
+		unsigned int begin;
+		unsigned int end;
+	};
+	std::vector<Slice> slices;
+	bool steal (unsigned int worker);
+public:
+	WorkStealingRanges (unsigned int begin, unsigned int end, unsigned int number_workers);
+	/**
+	 * @brief next Get the next index to process by the given worker.
+	 * @return false if there are no more indexes to process.
+	 */
+	bool next (unsigned int worker, unsigned int &index);
+};
+
+/**
+ * @brief The WorkerPool class is a fork-join pool of threads.  The calling
+ * thread takes part in the work as worker zero.
+ */
+class WorkerPool
+{
+	class Implementation;
+	Implementation *implementation;
+	WorkerPool (unsigned int number_workers);
+public:
+	~WorkerPool ();
+	/**
+	 * Return a pool with the given number of workers.  There is one pool for
+	 * each number of workers, created the first time it is requested and
+	 * kept until the program ends, so a reference stays valid.
+	 */
+	static WorkerPool &instance (unsigned int number_workers);
+	unsigned int size () const;
+	/**
+	 * @brief run Run the job in all workers and wait for them to finish.  The
+	 * job receives the worker index.  If called from inside a job, the job is
+	 * only run by the calling thread.
+	 */
+	void run (const std::function<void (unsigned int)> &job);
+};
+
+/**
+ * @brief parallel_ordered Apply map to every index in the closed range
+ * [first, last] using a pool of threads and pass the results to consume in
+ * index order on the calling thread.
+ *
+ * Indexes are processed in blocks so that only a bounded number of results is
+ * kept in memory.  The map function must be safe to call concurrently.
+ */
+template<typename R, typename M, typename C>
+void parallel_ordered (unsigned int number_threads, unsigned int first, unsigned int last, M map, C consume)
+{
+	if (first > last)
+		return ;
+	if (number_threads <= 1 || first == last) {
+		for (unsigned int index = first; index <= last; index++) {
+			R value = map (index);
+			consume (index, value);
+		}
+		return ;
+	}
+	WorkerPool &pool = WorkerPool::instance (number_threads);
+	const unsigned int block_size = 16 * pool.size ();
+	std::vector<R> results (block_size);
+	for (unsigned int block_first = first; block_first <= last; ) {
+		unsigned int block_last = std::min (last, block_first + block_size - 1);
+		WorkStealingRanges ranges (block_first, block_last + 1, pool.size ());
+		pool.run ([&] (unsigned int worker) {
+			unsigned int index;
+			while (ranges.next (worker, index))
+				results [index - block_first] = map (index);
+		});
+		for (unsigned int index = block_first; index <= block_last; index++) {
+			consume (index, results [index - block_first]);
+			results [index - block_first] = R ();
+		}
+		if (block_last == last)
+			break;
+		block_first = block_last + 1;
+	}
+}
+
+#endif
@@ -0,0 +1,366 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <thread>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "frame-manifest.hpp"
+#include "frame-executor.hpp"
+#include "frame-source.hpp"
+#include "feature-engine.hpp"
+
+using namespace std;
+
+static const unsigned int FRAME_MANIFEST_VERSION = 2;
+
+FrameNaming::FrameNaming (const string &frame_name_template, const string &frame_file_type):
+	width (0)
+{
+	size_t percent = frame_name_template.find ('%');
+	size_t conversion = percent == string::npos ? string::npos : frame_name_template.find_first_not_of ("0123456789", percent + 1);
+	if (conversion == string::npos
+	    || (frame_name_template [conversion] != 'd' && frame_name_template [conversion] != 'u')
+	    || frame_name_template.find ('%', conversion) != string::npos) {
+		fprintf (stderr, "Frame name template %s must have a single conversion like %%04d!\n", frame_name_template.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	this->prefix = frame_name_template.substr (0, percent);
+	this->suffix = frame_name_template.substr (conversion + 1) + "." + frame_file_type;
+	this->width = atoi (frame_name_template.substr (percent + 1, conversion - percent - 1).c_str ());
+}
+
+string FrameNaming::filename (const string &folder, unsigned int index_frame) const
+{
+	string number = to_string (index_frame);
+	if (number.size () < this->width)
+		number.insert (0, this->width - number.size (), '0');
+	return folder + this->prefix + number + this->suffix;
+}
+
+bool FrameNaming::parse (const string &name, unsigned int &index_frame) const
+{
+	if (name.size () <= this->prefix.size () + this->suffix.size ()
+	    || name.compare (0, this->prefix.size (), this->prefix) != 0
+	    || name.compare (name.size () - this->suffix.size (), this->suffix.size (), this->suffix) != 0)
+		return false;
+	string number = name.substr (this->prefix.size (), name.size () - this->prefix.size () - this->suffix.size ());
+	if (number.find_first_not_of ("0123456789") != string::npos || number.size () > 20)
+		return false;
+	unsigned long long value = strtoull (number.c_str (), NULL, 10);
+	if (value > numeric_limits<unsigned int>::max ())
+		return false;
+	index_frame = value;
+	// names with another padding are not frames
+	return this->filename ("", index_frame) == name;
+}
+
+/**
+ * List the folder and return the number of frames that exist without gaps
+ * from the first frame.
+ */
+static unsigned int list_frames (const string &folder, const FrameNaming &naming)
+{
+	DIR *directory = opendir (folder.c_str ());
+	if (directory == NULL) {
+		fprintf (stderr, "Could not list folder %s!\n", folder.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	set<unsigned int> indexes;
+	struct dirent *entry;
+	unsigned int index_frame;
+	while ((entry = readdir (directory)) != NULL)
+		if (naming.parse (entry->d_name, index_frame))
+			indexes.insert (index_frame);
+	closedir (directory);
+	unsigned int result = 0;
+	while (indexes.count (result + 1) == 1)
+		result++;
+	if (indexes.size () > result)
+		fprintf (stderr, "Frame %u is missing in folder %s, ignoring the %d frame(s) after it\n", result + 1, folder.c_str (), (int) (indexes.size () - result));
+	return result;
+}
+
+/**
+ * Lock the manifest file for the calling process.  Runs on the same folder at
+ * the same time, such as the runs of its shards, wait for the one that builds
+ * the manifest and then read it, instead of all hashing the frames.
+ *
+ * @return the descriptor of the lock file, to close to unlock it, or -1 if
+ * the manifest could not be locked.
+ */
+static int lock_manifest (const string &filename)
+{
+	int result = open ((filename + ".lock").c_str (), O_RDWR | O_CREAT, 0644);
+	if (result != -1 && flock (result, LOCK_EX) != 0) {
+		close (result);
+		result = -1;
+	}
+	return result;
+}
+
+FrameManifest::FrameManifest (const string &folder, const string &frame_name_template, const string &frame_file_type, bool verify_frames):
+	folder (folder),
+	frame_name_template (frame_name_template),
+	frame_file_type (frame_file_type),
+	naming (frame_name_template, frame_file_type)
+{
+	int lock = lock_manifest (this->filename ());
+	if (!this->read () || !this->valid () || !this->refresh (verify_frames))
+		this->build ();
+	else if (access (this->naming.filename (this->folder, this->frames.size () + 1).c_str (), F_OK) == 0)
+		this->extend ();
+	if (lock != -1)
+		close (lock);
+}
+
+bool FrameManifest::update ()
+{
+	unsigned int number_frames = this->frames.size ();
+	if (access (this->naming.filename (this->folder, number_frames + 1).c_str (), F_OK) == 0)
+		this->extend ();
+	return this->frames.size () > number_frames;
+}
+
+string FrameManifest::filename () const
+{
+	return this->folder + "frames-manifest_" + this->frame_file_type + ".txt";
+}
+
+bool FrameManifest::stat_file (const string &filename, Entry &entry)
+{
+	struct stat status;
+	entry.hash = 0;
+	if (stat (filename.c_str (), &status) != 0) {
+		entry.size = 0;
+		entry.mtime_seconds = 0;
+		entry.mtime_nanoseconds = 0;
+		return false;
+	}
+	entry.size = status.st_size;
+	entry.mtime_seconds = status.st_mtim.tv_sec;
+	entry.mtime_nanoseconds = status.st_mtim.tv_nsec;
+	return true;
+}
+
+uint64_t FrameManifest::hash_file (const string &filename)
+{
+	uint64_t result = HASH_SEED;
+	FILE *file = fopen (filename.c_str (), "rb");
+	if (file == NULL)
+		return result;
+	unsigned char buffer [65536];
+	size_t count;
+	while ((count = fread (buffer, 1, sizeof (buffer), file)) > 0)
+		result = hash_data (buffer, count, result);
+	fclose (file);
+	return result;
+}
+
+uint64_t FrameManifest::hash_data (const void *data, size_t size, uint64_t hash)
+{
+	// 64 bit FNV-1a
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (size_t index = 0; index < size; index++) {
+		hash ^= bytes [index];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t FrameManifest::contents_hash (unsigned int number_frames) const
+{
+	uint64_t result = hash_data (&this->background.hash, sizeof (this->background.hash));
+	unsigned int last_frame = min (number_frames, (unsigned int) this->frames.size ());
+	for (unsigned int index_frame = 1; index_frame <= last_frame; index_frame++)
+		result = hash_data (&this->frame (index_frame).hash, sizeof (uint64_t), result);
+	uint64_t count = number_frames;
+	return hash_data (&count, sizeof (count), result);
+}
+
+uint64_t FrameManifest::contents_hash (unsigned int number_frames, const Entry &frames_file) const
+{
+	uint64_t result = hash_data (&this->background.hash, sizeof (this->background.hash));
+	result = hash_data (&frames_file, sizeof (frames_file), result);
+	uint64_t count = number_frames;
+	return hash_data (&count, sizeof (count), result);
+}
+
+bool FrameManifest::read ()
+{
+	FILE *file = fopen (this->filename ().c_str (), "r");
+	if (file == NULL)
+		return false;
+	unsigned int version, number_frames;
+	char frame_name_template [256];
+	bool ok =
+	      fscanf (file, "AVFM %u\n", &version) == 1
+	      && version == FRAME_MANIFEST_VERSION
+	      && fscanf (file, "naming %255[^\n]\n", frame_name_template) == 1
+	      && this->frame_name_template == frame_name_template
+	      && fscanf (file, "background %" SCNu64 " %" SCNd64 " %" SCNd64 " %" SCNx64 " %d %d\n",
+	                 &this->background.size, &this->background.mtime_seconds, &this->background.mtime_nanoseconds, &this->background.hash,
+	                 &this->background_size.width, &this->background_size.height) == 6
+	      && fscanf (file, "frames %u\n", &number_frames) == 1;
+	if (ok) {
+		this->frames.resize (number_frames);
+		for (Entry &entry : this->frames)
+			ok = ok && fscanf (file, "%" SCNu64 " %" SCNd64 " %" SCNd64 " %" SCNx64 "\n",
+			                   &entry.size, &entry.mtime_seconds, &entry.mtime_nanoseconds, &entry.hash) == 4;
+	}
+	fclose (file);
+	if (!ok) {
+		fprintf (stderr, "Frame manifest %s is not valid, rebuilding it\n", this->filename ().c_str ());
+		this->frames.clear ();
+	}
+	return ok;
+}
+
+bool FrameManifest::valid () const
+{
+	Entry entry;
+	stat_file (this->folder + "background." + this->frame_file_type, entry);
+	return entry == this->background;
+}
+
+/**
+ * Check the size and modification time of the first and last frames.  If
+ * files were added to or removed from the folder after the manifest was
+ * written, check that the frames are still listed.
+ *
+ * @return true if the manifest looks up to date.
+ */
+bool FrameManifest::sample () const
+{
+	if (this->frames.empty ())
+		return true;
+	Entry entry;
+	for (unsigned int index_frame : {1u, (unsigned int) this->frames.size ()})
+		if (!stat_file (this->naming.filename (this->folder, index_frame), entry) || !(entry == this->frames [index_frame - 1]))
+			return false;
+	// method write gives the manifest file the modification time of the folder
+	Entry directory, manifest;
+	if (!stat_file (this->folder, directory) || !stat_file (this->filename (), manifest))
+		return false;
+	if (directory.mtime_seconds == manifest.mtime_seconds && directory.mtime_nanoseconds == manifest.mtime_nanoseconds)
+		return true;
+	return list_frames (this->folder, this->naming) >= this->frames.size ();
+}
+
+/**
+ * Check a sample of the frames, or every frame if requested or if the sample
+ * differs, and hash again the frames that were replaced.
+ *
+ * @return false if a frame no longer exists.
+ */
+bool FrameManifest::refresh (bool verify_frames)
+{
+	if (!verify_frames && this->sample ())
+		return true;
+	enum {SAME, REPLACED, MISSING};
+	vector<unsigned int> replaced;
+	bool missing = false;
+	auto check = [this] (unsigned int index_frame) {
+		Entry entry;
+		if (!stat_file (this->naming.filename (this->folder, index_frame), entry))
+			return (int) MISSING;
+		return entry == this->frames [index_frame - 1] ? (int) SAME : (int) REPLACED;
+	};
+	auto collect = [&] (unsigned int index_frame, int state) {
+		if (state == REPLACED)
+			replaced.push_back (index_frame);
+		missing = missing || state == MISSING;
+	};
+	parallel_ordered<int> (max (1u, thread::hardware_concurrency ()), 1, this->frames.size (), check, collect);
+	if (missing)
+		return false;
+	if (!replaced.empty ()) {
+		fprintf (stderr, "Frame %u and %d other frame(s) in folder %s were replaced, updating the frame manifest\n", replaced [0], (int) replaced.size () - 1, this->folder.c_str ());
+		for (unsigned int index_frame : replaced)
+			this->frames [index_frame - 1] = this->describe_frame (index_frame);
+		this->write ();
+	}
+	return true;
+}
+
+void FrameManifest::build ()
+{
+	fprintf (stderr, "Building frame manifest of folder %s...\n", this->folder.c_str ());
+	string background_filename = this->folder + "background." + this->frame_file_type;
+	if (stat_file (background_filename, this->background)) {
+		this->background.hash = hash_file (background_filename);
+		this->background_size = cv::imread (background_filename, CV_LOAD_IMAGE_GRAYSCALE).size ();
+	}
+	else
+		this->background_size = cv::Size ();
+	this->frames.resize (list_frames (this->folder, this->naming));
+	this->hash_frames (1, this->frames.size ());
+	this->write ();
+}
+
+void FrameManifest::extend ()
+{
+	unsigned int first = this->frames.size () + 1;
+	unsigned int number_frames = list_frames (this->folder, this->naming);
+	if (number_frames < first) {
+		this->build ();
+		return ;
+	}
+	fprintf (stderr, "Adding frames %d to %d to the frame manifest of folder %s...\n", first, number_frames, this->folder.c_str ());
+	this->frames.resize (number_frames);
+	this->hash_frames (first, number_frames);
+	this->write ();
+}
+
+FrameManifest::Entry FrameManifest::describe_frame (unsigned int index_frame) const
+{
+	Entry result;
+	string filename = this->naming.filename (this->folder, index_frame);
+	stat_file (filename, result);
+	result.hash = hash_file (filename);
+	return result;
+}
+
+void FrameManifest::hash_frames (unsigned int first, unsigned int last)
+{
+	auto describe = [this] (unsigned int index_frame) {
+		return this->describe_frame (index_frame);
+	};
+	auto store = [this] (unsigned int index_frame, const Entry &entry) {
+		this->frames [index_frame - 1] = entry;
+		if (index_frame % 1000 == 0) {
+			fprintf (stderr, "\r    %d", index_frame);
+			fflush (stderr);
+		}
+	};
+	parallel_ordered<Entry> (max (1u, thread::hardware_concurrency ()), first, last, describe, store);
+	if (last >= 1000)
+		fprintf (stderr, "\n");
+}
+
+void FrameManifest::write () const
+{
+	CacheFile file (this->filename ());
+	fprintf (file.get (), "AVFM %u\n", FRAME_MANIFEST_VERSION);
+	fprintf (file.get (), "naming %s\n", this->frame_name_template.c_str ());
+	fprintf (file.get (), "background %" PRIu64 " %" PRId64 " %" PRId64 " %016" PRIx64 " %d %d\n",
+	         this->background.size, this->background.mtime_seconds, this->background.mtime_nanoseconds, this->background.hash,
+	         this->background_size.width, this->background_size.height);
+	fprintf (file.get (), "frames %u\n", (unsigned int) this->frames.size ());
+	for (const Entry &entry : this->frames)
+		fprintf (file.get (), "%" PRIu64 " %" PRId64 " %" PRId64 " %016" PRIx64 "\n",
+		         entry.size, entry.mtime_seconds, entry.mtime_nanoseconds, entry.hash);
+	file.commit ();
+	// committing changed the folder, which is not changed by setting the time
+	struct stat status;
+	if (stat (this->folder.c_str (), &status) == 0) {
+		struct timespec times[2] = {status.st_mtim, status.st_mtim};
+		utimensat (AT_FDCWD, this->filename ().c_str (), times, 0);
+	}
+}
@@ -0,0 +1,163 @@
+#ifndef __FRAME_MANIFEST__
+#define __FRAME_MANIFEST__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * Template of the names of the frames that are extracted from a video.
+ */
+#define DEFAULT_FRAME_NAME_TEMPLATE "frames-%04d"
+
+/**
+ * @brief The FrameNaming class gives the names of the files with the video
+ * frames extracted in a folder.  A name is made of a printf style template
+ * followed by the frame file type.  The template has a single conversion,
+ * %d or %u, which is replaced by the frame index.  Like ffmpeg, a conversion
+ * with a width, as in %04d or %6d, pads the index with zeros.  Indexes wider
+ * than the padding are written in full.
+ */
+class FrameNaming
+{
+	std::string prefix;
+	std::string suffix;
+	unsigned int width;
+public:
+	/**
+	 * Exits if the template does not have a single integer conversion.
+	 */
+	FrameNaming (const std::string &frame_name_template, const std::string &frame_file_type);
+	/**
+	 * Return the name of the file with the given frame.  The folder must end
+	 * with a slash.
+	 */
+	std::string filename (const std::string &folder, unsigned int index_frame) const;
+	/**
+	 * @brief parse Get the frame index from a file name without folder.
+	 * @return false if the name is not the name of a frame.
+	 */
+	bool parse (const std::string &name, unsigned int &index_frame) const;
+};
+
+/**
+ * @brief The FrameManifest class describes the video frames extracted in an
+ * experiment folder and the background image: the number of frames, the size
+ * of the background image and, for each file, its size, modification time and
+ * a hash of its contents.
+ *
+ * The manifest is kept in a file in the folder.  It is built once, by listing
+ * the folder and reading every frame, and afterwards it is validated by
+ * checking the size and modification time of the background image and of
+ * the first and last frames.  The folder is listed again only if it changed
+ * after the manifest was written.  Checking every frame is optional, in which
+ * case frames that were replaced are hashed again.  Frames added after the
+ * last one are appended to the manifest.  Runs that start on a folder at the
+ * same time take turns, so the manifest is only built by the first one.
+ */
+class FrameManifest
+{
+public:
+	/**
+	 * @brief The Entry struct has the properties of an image file.
+	 */
+	struct Entry {
+		uint64_t size;
+		int64_t mtime_seconds;
+		int64_t mtime_nanoseconds;
+		uint64_t hash;
+		bool operator== (const Entry &other) const
+		{
+			return this->size == other.size
+			      && this->mtime_seconds == other.mtime_seconds
+			      && this->mtime_nanoseconds == other.mtime_nanoseconds;
+		}
+	};
+private:
+	const std::string folder;
+	const std::string frame_name_template;
+	const std::string frame_file_type;
+	const FrameNaming naming;
+	Entry background;
+	cv::Size background_size;
+	std::vector<Entry> frames;
+	bool read ();
+	bool valid () const;
+	bool sample () const;
+	bool refresh (bool verify_frames);
+	void build ();
+	void extend ();
+	void write () const;
+	void hash_frames (unsigned int first, unsigned int last);
+	Entry describe_frame (unsigned int index_frame) const;
+public:
+	/**
+	 * @brief FrameManifest Read the manifest of the given folder, which must
+	 * end with a slash.  The manifest is built or updated if needed.
+	 * @param verify_frames Check the size and modification time of every
+	 * frame instead of a sample of them.
+	 */
+	FrameManifest (const std::string &folder, const std::string &frame_name_template, const std::string &frame_file_type, bool verify_frames = false);
+	const std::string &get_folder () const
+	{
+		return this->folder;
+	}
+	const FrameNaming &get_naming () const
+	{
+		return this->naming;
+	}
+	unsigned int number_frames () const
+	{
+		return this->frames.size ();
+	}
+	/**
+	 * Return the size of the background image, which all frames have.
+	 */
+	const cv::Size &frame_size () const
+	{
+		return this->background_size;
+	}
+	/**
+	 * Return the entry of the given frame.  Frames start at one.
+	 */
+	const Entry &frame (unsigned int index_frame) const
+	{
+		return this->frames [index_frame - 1];
+	}
+	std::string filename () const;
+	/**
+	 * @brief update Add to the manifest the frames that were extracted after
+	 * the last one.
+	 * @return true if there are new frames.
+	 */
+	bool update ();
+	/**
+	 * @brief contents_hash Return a hash of the contents of the background
+	 * image and of the given number of frames from the first.  It changes if
+	 * any of them is replaced.  Only the frames in the manifest are hashed.
+	 */
+	uint64_t contents_hash (unsigned int number_frames) const;
+	/**
+	 * @brief contents_hash Return a hash of the contents of the background
+	 * image and of the given number of frames stored in a single file, such as
+	 * a video, that is identified by its entry.
+	 */
+	uint64_t contents_hash (unsigned int number_frames, const Entry &frames_file) const;
+	/**
+	 * @brief stat_file Fill the size and modification time of an entry.
+	 * @return false if the file does not exist.
+	 */
+	static bool stat_file (const std::string &filename, Entry &entry);
+	/**
+	 * @brief hash_file Compute the hash of the contents of a file.
+	 */
+	static uint64_t hash_file (const std::string &filename);
+	static const uint64_t HASH_SEED = 14695981039346656037ULL;
+	/**
+	 * @brief hash_data Continue the given hash with the given bytes.
+	 */
+	static uint64_t hash_data (const void *data, size_t size, uint64_t hash = HASH_SEED);
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include "frame-pool.hpp"
+
+using namespace std;
+
+/**
+ * Return the number of matrices that share the buffer of the given matrix.
+ */
+static int reference_count (const cv::Mat &mat)
+{
+#if CV_MAJOR_VERSION >= 3
+	return mat.u != NULL ? CV_XADD (&mat.u->refcount, 0) : 0;
+#else
+	return mat.refcount != NULL ? CV_XADD (mat.refcount, 0) : 0;
+#endif
+}
+
+FramePool::FramePool ():
+	allocations (0),
+	reuses (0),
+	unpooled (0)
+{
+}
+
+FramePool &FramePool::instance ()
+{
+	static FramePool pool;
+	return pool;
+}
+
+cv::Mat FramePool::acquire (int rows, int cols, int type)
+{
+	lock_guard<std::mutex> lock (this->mutex);
+	Bucket &bucket = this->buckets [Geometry (rows, cols, type)];
+	// buffers are lent in turn, so the one after the last lent is likely free
+	for (size_t count = 0; count < bucket.buffers.size (); count++) {
+		size_t index = (bucket.next + count) % bucket.buffers.size ();
+		// the pool has the only reference to a free buffer
+		if (reference_count (bucket.buffers [index]) == 1) {
+			bucket.next = index + 1;
+			this->reuses++;
+			return bucket.buffers [index];
+		}
+	}
+	if (bucket.buffers.size () >= FRAME_POOL_CAPACITY) {
+		this->unpooled++;
+		return cv::Mat (rows, cols, type);
+	}
+	bucket.buffers.push_back (cv::Mat (rows, cols, type));
+	bucket.next = 0;
+	this->allocations++;
+	return bucket.buffers.back ();
+}
+
+void FramePool::trim ()
+{
+	lock_guard<std::mutex> lock (this->mutex);
+	for (auto iterator = this->buckets.begin (); iterator != this->buckets.end (); ) {
+		vector<cv::Mat> &buffers = iterator->second.buffers;
+		buffers.erase (remove_if (buffers.begin (), buffers.end (), [] (const cv::Mat &buffer) {
+			return reference_count (buffer) == 1;
+		}), buffers.end ());
+		iterator->second.next = 0;
+		if (buffers.empty ())
+			iterator = this->buckets.erase (iterator);
+		else
+			iterator++;
+	}
+}
+
+unsigned long FramePool::number_allocations () const
+{
+	lock_guard<std::mutex> lock (this->mutex);
+	return this->allocations;
+}
+
+unsigned long FramePool::number_reuses () const
+{
+	lock_guard<std::mutex> lock (this->mutex);
+	return this->reuses;
+}
+
+void FramePool::report (FILE *file) const
+{
+	lock_guard<std::mutex> lock (this->mutex);
+	fprintf (file, "Frame pool: %lu buffer(s) allocated, %lu reuse(s), %lu buffer(s) beyond capacity\n", this->allocations, this->reuses, this->unpooled);
+}
@@ -0,0 +1,81 @@
+#ifndef __FRAME_POOL__
+#define __FRAME_POOL__
+
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * Maximum number of buffers of each geometry kept by the frame pool.
+ */
+#define FRAME_POOL_CAPACITY 64
+
+/**
+ * @brief The FramePool class keeps the image buffers used by the decode and
+ * processing stages so that they are reused instead of being allocated for
+ * every frame.
+ *
+ * A buffer is borrowed with method acquire, which returns a matrix that shares
+ * the buffer with the pool.  The buffer returns to the pool when all the
+ * matrices that share it are released, for instance when a frame leaves the
+ * window of previous frames of the pixel count difference.  Once the number of
+ * frames in flight stops growing, processing does not allocate image buffers.
+ *
+ * Buffers are kept per geometry, and at most #FRAME_POOL_CAPACITY of each.
+ * Buffers acquired beyond that are not pooled and are freed when released.
+ * Free buffers are released by method trim, which the feature engine calls
+ * after each pass over the video frames.
+ */
+class FramePool
+{
+	typedef std::tuple<int, int, int> Geometry;
+	/**
+	 * Buffers of a geometry and where to start looking for a free one.
+	 */
+	struct Bucket {
+		std::vector<cv::Mat> buffers;
+		size_t next;
+	};
+	mutable std::mutex mutex;
+	std::map<Geometry, Bucket> buckets;
+	unsigned long allocations;
+	unsigned long reuses;
+	unsigned long unpooled;
+	FramePool ();
+public:
+	/**
+	 * Return the pool shared by all frame sources and processing functions.
+	 */
+	static FramePool &instance ();
+	/**
+	 * @brief acquire Return a matrix with the given geometry whose buffer is
+	 * not used by anyone else.  The contents are undefined.  A new buffer is
+	 * allocated if all the buffers with this geometry are in use.
+	 */
+	cv::Mat acquire (int rows, int cols, int type);
+	cv::Mat acquire (const cv::Size &size, int type)
+	{
+		return this->acquire (size.height, size.width, type);
+	}
+	/**
+	 * @brief trim Release the buffers that are not in use.
+	 */
+	void trim ();
+	/**
+	 * @brief number_allocations Number of buffers allocated by the pool.
+	 */
+	unsigned long number_allocations () const;
+	/**
+	 * @brief number_reuses Number of times a buffer was lent again.
+	 */
+	unsigned long number_reuses () const;
+	/**
+	 * Print the allocation counters.
+	 */
+	void report (FILE *file) const;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <algorithm>
+
+#include "frame-prefetcher.hpp"
+
+using namespace std;
+
+FramePrefetcher::FramePrefetcher (FrameSource &source, unsigned int first, unsigned int last, unsigned int depth, unsigned int number_threads):
+	source (source),
+	last (last),
+	slots (max (1u, depth)),
+	next_decode (first),
+	next_consume (first),
+	stop (false)
+{
+	for (Slot &slot : this->slots)
+		slot.ready = false;
+	// hint the frames of the first ring
+	for (unsigned int index_frame = first; index_frame <= last && index_frame < first + this->slots.size (); index_frame++)
+		this->source.will_need (index_frame);
+	unsigned int number_decoders = source.sequential () ? 1 : max (1u, min (number_threads, (unsigned int) this->slots.size ()));
+	for (unsigned int index = 0; index < number_decoders; index++)
+		this->decoders.push_back (thread (&FramePrefetcher::decode, this));
+}
+
+FramePrefetcher::~FramePrefetcher ()
+{
+	{
+		lock_guard<std::mutex> lock (this->mutex);
+		this->stop = true;
+	}
+	this->slot_free.notify_all ();
+	for (thread &decoder : this->decoders)
+		decoder.join ();
+}
+
+void FramePrefetcher::decode ()
+{
+	const unsigned int depth = this->slots.size ();
+	while (true) {
+		unsigned int index_frame;
+		{
+			unique_lock<std::mutex> lock (this->mutex);
+			// a frame is decoded when its slot was released by the consumer
+			this->slot_free.wait (lock, [this, depth] {
+				return this->stop || this->next_decode > this->last || this->next_decode < this->next_consume + depth;
+			});
+			if (this->stop || this->next_decode > this->last)
+				return ;
+			index_frame = this->next_decode++;
+		}
+		// the frame that takes the slot of this one after it is consumed
+		if (index_frame + depth <= this->last)
+			this->source.will_need (index_frame + depth);
+		cv::Mat frame = this->source.read (index_frame);
+		{
+			lock_guard<std::mutex> lock (this->mutex);
+			Slot &slot = this->slots [index_frame % depth];
+			slot.index_frame = index_frame;
+			slot.frame = frame;
+			slot.ready = true;
+		}
+		this->slot_ready.notify_all ();
+	}
+}
+
+cv::Mat FramePrefetcher::next ()
+{
+	cv::Mat result;
+	{
+		unique_lock<std::mutex> lock (this->mutex);
+		Slot &slot = this->slots [this->next_consume % this->slots.size ()];
+		this->slot_ready.wait (lock, [this, &slot] {
+			return slot.ready && slot.index_frame == this->next_consume;
+		});
+		result = slot.frame;
+		slot.frame.release ();
+		slot.ready = false;
+		this->next_consume++;
+	}
+	this->slot_free.notify_all ();
+	return result;
+}
@@ -0,0 +1,65 @@
+#ifndef __FRAME_PREFETCHER__
+#define __FRAME_PREFETCHER__
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "frame-source.hpp"
+
+/**
+ * @brief The FramePrefetcher class decodes the frames of a range ahead of
+ * their use.  Decoder threads fill a ring of slots with the frames that follow
+ * the last consumed one, while the calling thread takes the frames in order
+ * with method next.  At most depth frames are decoded ahead, which bounds the
+ * memory used.
+ *
+ * Decoding overlaps with the processing of the consumed frames.  This hides
+ * the latency of reading frames from slow file systems, such as network
+ * mounted folders.  The frame source is told which frames are going to be
+ * read so that it can start fetching them.
+ */
+class FramePrefetcher
+{
+	struct Slot {
+		unsigned int index_frame;
+		bool ready;
+		cv::Mat frame;
+	};
+	FrameSource &source;
+	const unsigned int last;
+	std::vector<Slot> slots;
+	std::mutex mutex;
+	std::condition_variable slot_ready;
+	std::condition_variable slot_free;
+	/**
+	 * Index of the next frame to give to a decoder thread.
+	 */
+	unsigned int next_decode;
+	/**
+	 * Index of the frame that method next returns.
+	 */
+	unsigned int next_consume;
+	bool stop;
+	std::vector<std::thread> decoders;
+	void decode ();
+public:
+	/**
+	 * @brief FramePrefetcher Start decoding the frames in the closed range
+	 * [first, last].  Sequential frame sources are decoded by a single thread.
+	 */
+	FramePrefetcher (FrameSource &source, unsigned int first, unsigned int last, unsigned int depth, unsigned int number_threads);
+	/**
+	 * Stops the decoder threads.  Frames that were not consumed are dropped.
+	 */
+	~FramePrefetcher ();
+	/**
+	 * @brief next Return the next frame of the range, waiting for it to be
+	 * decoded.  Must only be called by one thread.
+	 */
+	cv::Mat next ();
+};
+
+#endif
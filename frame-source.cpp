@@ -0,0 +1,227 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+
+#include "frame-source.hpp"
+#include "frame-executor.hpp"
+#include "frame-pool.hpp"
+#include "feature-engine.hpp"
+
+using namespace std;
+
+static const char RAW_FRAMES_MAGIC[4] = {'A', 'V', 'R', 'F'};
+static const uint32_t RAW_FRAMES_VERSION = 1;
+/**
+ * Frames and rows are aligned to this number of bytes.
+ */
+static const uint32_t RAW_FRAMES_ALIGNMENT = 64;
+static const size_t RAW_FRAMES_HEADER_SIZE = 4096;
+
+FrameSource *FrameSource::create (const FrameManifest &manifest, const string &video_filename)
+{
+	string packed_filename = RawFrameSource::packed_filename (manifest.get_folder ());
+	if (access (packed_filename.c_str (), F_OK) == 0)
+		return new RawFrameSource (packed_filename);
+	else if (video_filename.empty ())
+		return new FolderFrameSource (manifest);
+	else
+		return new VideoFrameSource (video_filename);
+}
+
+FolderFrameSource::FolderFrameSource (const FrameManifest &manifest):
+	folder (manifest.get_folder ()),
+	naming (manifest.get_naming ()),
+	frames (manifest.number_frames ())
+{
+}
+
+cv::Mat FolderFrameSource::read (unsigned int index_frame)
+{
+	static thread_local vector<unsigned char> buffer;
+	// size of the last frame decoded by this thread
+	static thread_local cv::Size size;
+	string filename = this->naming.filename (this->folder, index_frame);
+	int descriptor = open (filename.c_str (), O_RDONLY);
+	struct stat status;
+	if (descriptor == -1 || fstat (descriptor, &status) != 0) {
+		fprintf (stderr, "There is no such image: %s\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	buffer.resize (status.st_size);
+	size_t position = 0;
+	while (position < buffer.size ()) {
+		ssize_t count = ::read (descriptor, buffer.data () + position, buffer.size () - position);
+		if (count <= 0) {
+			fprintf (stderr, "Could not read image: %s\n", filename.c_str ());
+			exit (EXIT_FAILURE);
+		}
+		position += count;
+	}
+	close (descriptor);
+	// the decoder writes in the pooled frame if it has the size of the image
+	cv::Mat result;
+	if (size.area () > 0)
+		result = FramePool::instance ().acquire (size, CV_8UC1);
+	if (cv::imdecode (buffer, CV_LOAD_IMAGE_GRAYSCALE, &result).empty ()) {
+		fprintf (stderr, "Could not decode image: %s\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	size = result.size ();
+	return result;
+}
+
+void FolderFrameSource::will_need (unsigned int index_frame)
+{
+	string filename = this->naming.filename (this->folder, index_frame);
+	int descriptor = open (filename.c_str (), O_RDONLY);
+	if (descriptor != -1) {
+		posix_fadvise (descriptor, 0, 0, POSIX_FADV_WILLNEED);
+		close (descriptor);
+	}
+}
+
+VideoFrameSource::VideoFrameSource (const string &filename):
+	filename (filename),
+	capture (filename),
+	next_index_frame (1),
+	frames (0)
+{
+	if (!this->capture.isOpened ()) {
+		fprintf (stderr, "Could not open video %s!\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	this->frames = this->capture.get (CV_CAP_PROP_FRAME_COUNT);
+}
+
+cv::Mat VideoFrameSource::read (unsigned int index_frame)
+{
+	lock_guard<std::mutex> lock (this->mutex);
+	if (index_frame != this->next_index_frame)
+		this->capture.set (CV_CAP_PROP_POS_FRAMES, index_frame - 1);
+	if (!this->capture.read (this->buffer)) {
+		fprintf (stderr, "Could not decode frame %d of video %s!\n", index_frame, this->filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	this->next_index_frame = index_frame + 1;
+	cv::Mat result = FramePool::instance ().acquire (this->buffer.rows, this->buffer.cols, CV_8UC1);
+	if (this->buffer.channels () == 1)
+		this->buffer.copyTo (result);
+	else
+		cv::cvtColor (this->buffer, result, CV_BGR2GRAY);
+	return result;
+}
+
+RawFrameSource::RawFrameSource (const string &filename):
+	filename (filename)
+{
+	struct stat status;
+	this->descriptor = open (filename.c_str (), O_RDONLY);
+	if (this->descriptor == -1 || fstat (this->descriptor, &status) != 0) {
+		fprintf (stderr, "Could not open packed frames %s!\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	this->size = status.st_size;
+	void *address = this->size >= RAW_FRAMES_HEADER_SIZE ? mmap (NULL, this->size, PROT_READ, MAP_SHARED, this->descriptor, 0) : MAP_FAILED;
+	if (address == MAP_FAILED) {
+		fprintf (stderr, "Could not map packed frames %s!\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	this->data = (unsigned char *) address;
+	uint32_t header [5];
+	memcpy (header, this->data + sizeof (RAW_FRAMES_MAGIC), sizeof (header));
+	this->width = header [1];
+	this->height = header [2];
+	this->frames = header [3];
+	this->stride = header [4];
+	if (memcmp (this->data, RAW_FRAMES_MAGIC, sizeof (RAW_FRAMES_MAGIC)) != 0
+	    || header [0] != RAW_FRAMES_VERSION
+	    || this->stride < this->width
+	    || this->size < RAW_FRAMES_HEADER_SIZE + (size_t) this->frames * this->height * this->stride) {
+		fprintf (stderr, "File %s does not have valid packed frames!\n", filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+}
+
+RawFrameSource::~RawFrameSource ()
+{
+	munmap (this->data, this->size);
+	close (this->descriptor);
+}
+
+cv::Mat RawFrameSource::read (unsigned int index_frame)
+{
+	if (index_frame < 1 || index_frame > this->frames) {
+		fprintf (stderr, "There is no frame %d in packed frames %s\n", index_frame, this->filename.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	unsigned char *frame = this->data + RAW_FRAMES_HEADER_SIZE + (size_t) (index_frame - 1) * this->height * this->stride;
+	return cv::Mat (this->height, this->width, CV_8UC1, frame, this->stride);
+}
+
+void RawFrameSource::will_need (unsigned int index_frame)
+{
+	if (index_frame < 1 || index_frame > this->frames)
+		return ;
+	size_t page_size = sysconf (_SC_PAGESIZE);
+	size_t begin = RAW_FRAMES_HEADER_SIZE + (size_t) (index_frame - 1) * this->height * this->stride;
+	size_t end = begin + (size_t) this->height * this->stride;
+	begin = begin / page_size * page_size;
+	madvise (this->data + begin, end - begin, MADV_WILLNEED);
+}
+
+string RawFrameSource::packed_filename (const string &folder)
+{
+	return folder + "frames-raw.bin";
+}
+
+void RawFrameSource::pack (const string &folder, const string &frame_name_template, const string &frame_file_type, const string &video_filename, unsigned int number_threads)
+{
+	string filename = RawFrameSource::packed_filename (folder);
+	if (access (filename.c_str (), F_OK) == 0) {
+		fprintf (stderr, "Frames are already packed in %s\n", filename.c_str ());
+		return ;
+	}
+	FrameManifest manifest (folder, frame_name_template, frame_file_type);
+	FrameSource *source = FrameSource::create (manifest, video_filename);
+	unsigned int number_frames = source->number_frames ();
+	if (number_frames == 0) {
+		fprintf (stderr, "There are no video frames to pack!\n");
+		exit (EXIT_FAILURE);
+	}
+	fprintf (stderr, "Packing %d video frames in file %s...\n", number_frames, filename.c_str ());
+	CacheFile file (filename);
+	cv::Mat first = source->read (1);
+	uint32_t header[] = {
+		RAW_FRAMES_VERSION,
+		(uint32_t) first.cols,
+		(uint32_t) first.rows,
+		number_frames,
+		(first.cols + RAW_FRAMES_ALIGNMENT - 1) / RAW_FRAMES_ALIGNMENT * RAW_FRAMES_ALIGNMENT
+	};
+	vector<unsigned char> padding (RAW_FRAMES_HEADER_SIZE, 0);
+	fwrite (RAW_FRAMES_MAGIC, sizeof (RAW_FRAMES_MAGIC), 1, file.get ());
+	fwrite (header, sizeof (header), 1, file.get ());
+	fwrite (padding.data (), 1, RAW_FRAMES_HEADER_SIZE - sizeof (RAW_FRAMES_MAGIC) - sizeof (header), file.get ());
+	auto decode = [source] (unsigned int index_frame) {
+		return source->read (index_frame);
+	};
+	auto write = [&] (unsigned int index_frame, const cv::Mat &frame) {
+		if (frame.cols != first.cols || frame.rows != first.rows) {
+			fprintf (stderr, "Frame %d does not have the size of the first frame!\n", index_frame);
+			exit (EXIT_FAILURE);
+		}
+		for (int y = 0; y < frame.rows; y++) {
+			fwrite (frame.ptr<unsigned char> (y), 1, frame.cols, file.get ());
+			fwrite (padding.data (), 1, header [4] - frame.cols, file.get ());
+		}
+		fprintf (stderr, "\r    %d", index_frame);
+		fflush (stderr);
+	};
+	parallel_ordered<cv::Mat> (source->sequential () ? 1 : number_threads, 1, number_frames, decode, write);
+	fprintf (stderr, "\n");
+	file.commit ();
+	delete source;
+}
@@ -0,0 +1,188 @@
+#ifndef __FRAME_SOURCE__
+#define __FRAME_SOURCE__
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "frame-manifest.hpp"
+
+/**
+ * @brief The FrameSource class provides the grey scale video frames to
+ * analyse.  Frames start at one.
+ */
+class FrameSource
+{
+public:
+	virtual ~FrameSource () {}
+	virtual unsigned int number_frames () const = 0;
+	/**
+	 * @brief read Decode the given frame.  Can be called concurrently, and in
+	 * any order, which the GUI uses for random access.
+	 */
+	virtual cv::Mat read (unsigned int index_frame) = 0;
+	/**
+	 * @brief sequential Return true if frames are best decoded one at a time
+	 * in increasing order.  Passes over the video frames then do not decode
+	 * frames in parallel.
+	 */
+	virtual bool sequential () const = 0;
+	/**
+	 * @brief will_need Hint that the given frame is going to be read soon.  A
+	 * frame source may start fetching the frame data in the background.
+	 */
+	virtual void will_need (unsigned int) {}
+	/**
+	 * @brief mapped Return true if reading a frame neither copies nor decodes
+	 * it, so reading a few of its pixels is cheap.
+	 */
+	virtual bool mapped () const
+	{
+		return false;
+	}
+	/**
+	 * @brief frames_filename Return the name of the file with all the frames,
+	 * or an empty string if each frame is in its own file.
+	 */
+	virtual std::string frames_filename () const
+	{
+		return "";
+	}
+	/**
+	 * Create the frame source of the packed frames in the folder of the
+	 * manifest if there are any.  Otherwise create the frame source of a video
+	 * file, or, if the video filename is empty, of the frames extracted in the
+	 * folder.
+	 */
+	static FrameSource *create (const FrameManifest &manifest, const std::string &video_filename);
+};
+
+/**
+ * @brief The FolderFrameSource class reads the frames that were extracted from
+ * a video to image files in a folder.
+ */
+class FolderFrameSource:
+	public FrameSource
+{
+	const std::string folder;
+	const FrameNaming naming;
+	const unsigned int frames;
+public:
+	/**
+	 * @brief FolderFrameSource Read the frames listed in the manifest of a
+	 * folder.
+	 */
+	FolderFrameSource (const FrameManifest &manifest);
+	virtual unsigned int number_frames () const
+	{
+		return this->frames;
+	}
+	/**
+	 * @brief read Read the encoded image file in a buffer that each thread
+	 * reuses and decode it.
+	 */
+	virtual cv::Mat read (unsigned int index_frame);
+	virtual bool sequential () const
+	{
+		return false;
+	}
+	/**
+	 * Ask the kernel to read ahead the image file of the frame.
+	 */
+	virtual void will_need (unsigned int index_frame);
+};
+
+/**
+ * @brief The VideoFrameSource class decodes frames from a video file.
+ * Decoding is sequential: reading the frame after the last read one continues
+ * decoding while reading any other frame seeks in the video.
+ */
+class VideoFrameSource:
+	public FrameSource
+{
+	const std::string filename;
+	cv::VideoCapture capture;
+	std::mutex mutex;
+	/**
+	 * Index of the frame that the next read of the video returns.
+	 */
+	unsigned int next_index_frame;
+	unsigned int frames;
+	cv::Mat buffer;
+public:
+	VideoFrameSource (const std::string &filename);
+	virtual unsigned int number_frames () const
+	{
+		return this->frames;
+	}
+	virtual cv::Mat read (unsigned int index_frame);
+	virtual bool sequential () const
+	{
+		return true;
+	}
+	virtual std::string frames_filename () const
+	{
+		return this->filename;
+	}
+};
+
+/**
+ * @brief The RawFrameSource class accesses the frames packed in a single file
+ * of grey scale pixels.  The file is mapped in memory, so reading a frame
+ * neither copies nor decodes it.  The frames returned by method read share
+ * the mapped memory, which is read only.
+ *
+ * The file has a header with a magic number, a version, the width, the
+ * height, the number of frames and the row stride.  Frames start at offset
+ * #RAW_FRAMES_HEADER_SIZE and each one has height times stride bytes.
+ */
+class RawFrameSource:
+	public FrameSource
+{
+	const std::string filename;
+	int descriptor;
+	size_t size;
+	unsigned char *data;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frames;
+	uint32_t stride;
+public:
+	RawFrameSource (const std::string &filename);
+	virtual ~RawFrameSource ();
+	virtual unsigned int number_frames () const
+	{
+		return this->frames;
+	}
+	virtual cv::Mat read (unsigned int index_frame);
+	virtual bool sequential () const
+	{
+		return false;
+	}
+	virtual bool mapped () const
+	{
+		return true;
+	}
+	virtual std::string frames_filename () const
+	{
+		return this->filename;
+	}
+	/**
+	 * Ask the kernel to page in the mapped memory of the frame.
+	 */
+	virtual void will_need (unsigned int index_frame);
+	/**
+	 * Return the name of the file with the packed frames of a folder.
+	 */
+	static std::string packed_filename (const std::string &folder);
+	/**
+	 * @brief pack Decode all the frames of a folder or video once and write
+	 * them to the packed frames file of the folder.  Nothing is done if the
+	 * folder already has packed frames.
+	 */
+	static void pack (const std::string &folder, const std::string &frame_name_template, const std::string &frame_file_type, const std::string &video_filename, unsigned int number_threads);
+};
+
+#endif
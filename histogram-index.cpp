@@ -0,0 +1,270 @@
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#include "histogram-index.hpp"
+#include "image.hpp"
+#include "parameters.hpp"
+
+using namespace std;
+
+static const char HISTOGRAM_INDEX_MAGIC[4] = {'A', 'V', 'H', 'I'};
+static const uint32_t HISTOGRAM_INDEX_VERSION = 4;
+
+template<typename T>
+static void append_value (vector<uint8_t> &buffer, T value)
+{
+	const uint8_t *bytes = (const uint8_t *) &value;
+	buffer.insert (buffer.end (), bytes, bytes + sizeof (T));
+}
+
+template<typename T>
+static bool extract_value (const vector<uint8_t> &buffer, size_t &position, T &value)
+{
+	if (position + sizeof (T) > buffer.size ())
+		return false;
+	memcpy (&value, &buffer [position], sizeof (T));
+	position += sizeof (T);
+	return true;
+}
+
+static void append_varint (vector<uint8_t> &buffer, unsigned int value)
+{
+	while (value >= 0x80) {
+		buffer.push_back ((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	buffer.push_back (value);
+}
+
+static bool extract_varint (const vector<uint8_t> &buffer, size_t &position, unsigned int &value)
+{
+	value = 0;
+	for (unsigned int shift = 0; shift < 32; shift += 7) {
+		if (position >= buffer.size ())
+			return false;
+		uint8_t byte = buffer [position++];
+		value |= (unsigned int) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Add to the histogram the pixels of rectangle (x1,y1)-(x2,y2) of the frame
+ * that are outside the inner rectangle.
+ */
+static void add_border_pixels (const cv::Mat &frame, int x1, int y1, int x2, int y2, const cv::Rect &inner, Histogram &histogram)
+{
+	for (int y = y1; y < y2; y++) {
+		const uchar *pixel = frame.ptr<uchar> (y);
+		if (y < inner.y || y >= inner.y + inner.height || inner.width == 0) {
+			for (int x = x1; x < x2; x++)
+				histogram [pixel [x]]++;
+			continue;
+		}
+		for (int x = x1; x < inner.x; x++)
+			histogram [pixel [x]]++;
+		for (int x = inner.x + inner.width; x < x2; x++)
+			histogram [pixel [x]]++;
+	}
+}
+
+TileHistograms::TileHistograms (unsigned int tile_size, const cv::Size &frame_size):
+	tile_size (tile_size),
+	width (frame_size.width),
+	height (frame_size.height),
+	columns ((frame_size.width + tile_size - 1) / tile_size),
+	rows ((frame_size.height + tile_size - 1) / tile_size),
+	counts (columns * rows * NUMBER_COLOUR_LEVELS)
+{
+}
+
+void TileHistograms::compute (const cv::Mat &frame)
+{
+	fill (this->counts.begin (), this->counts.end (), 0);
+	for (int y = 0; y < this->height; y++) {
+		const uchar *pixel = frame.ptr<uchar> (y);
+		uint16_t *tile_row = &this->counts [(y / this->tile_size) * this->columns * NUMBER_COLOUR_LEVELS];
+		for (int x = 0; x < this->width; x++)
+			tile_row [(x / this->tile_size) * NUMBER_COLOUR_LEVELS + pixel [x]]++;
+	}
+}
+
+cv::Rect TileHistograms::inner_rectangle (int x1, int y1, int x2, int y2) const
+{
+	const int size = this->tile_size;
+	// the tiles in the last row and column end at the border of the frame
+	int inner_x1 = (max (x1, 0) + size - 1) / size * size;
+	int inner_y1 = (max (y1, 0) + size - 1) / size * size;
+	int inner_x2 = x2 >= this->width ? this->width : max (x2, 0) / size * size;
+	int inner_y2 = y2 >= this->height ? this->height : max (y2, 0) / size * size;
+	if (inner_x1 >= inner_x2 || inner_y1 >= inner_y2)
+		return cv::Rect ();
+	return cv::Rect (inner_x1, inner_y1, inner_x2 - inner_x1, inner_y2 - inner_y1);
+}
+
+void TileHistograms::compose (const cv::Rect &inner, Histogram &histogram) const
+{
+	for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+		histogram [level] = 0;
+	const int size = this->tile_size;
+	for (int row = inner.y / size; row * size < inner.y + inner.height; row++)
+		for (int column = inner.x / size; column * size < inner.x + inner.width; column++) {
+			const uint16_t *tile = &this->counts [(row * this->columns + column) * NUMBER_COLOUR_LEVELS];
+			for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+				histogram [level] += tile [level];
+		}
+}
+
+void TileHistograms::write_header (FILE *file, unsigned int number_frames, const ColumnTable::Signature &signature) const
+{
+	uint32_t header[] = {HISTOGRAM_INDEX_VERSION, this->tile_size, (uint32_t) this->width, (uint32_t) this->height, number_frames};
+	uint64_t hashes[] = {signature.parameters, signature.frames};
+	fwrite (HISTOGRAM_INDEX_MAGIC, sizeof (HISTOGRAM_INDEX_MAGIC), 1, file);
+	fwrite (header, sizeof (header), 1, file);
+	fwrite (hashes, sizeof (hashes), 1, file);
+}
+
+bool TileHistograms::read_header (FILE *file, unsigned int &number_frames, ColumnTable::Signature &signature) const
+{
+	char magic [4];
+	uint32_t header [5];
+	uint64_t hashes [2];
+	bool ok =
+	      fread (magic, sizeof (magic), 1, file) == 1
+	      && memcmp (magic, HISTOGRAM_INDEX_MAGIC, sizeof (magic)) == 0
+	      && fread (header, sizeof (header), 1, file) == 1
+	      && header [0] == HISTOGRAM_INDEX_VERSION
+	      && header [1] == this->tile_size
+	      && header [2] == (uint32_t) this->width
+	      && header [3] == (uint32_t) this->height
+	      && fread (hashes, sizeof (hashes), 1, file) == 1;
+	number_frames = header [4];
+	signature = ColumnTable::Signature {hashes [0], hashes [1]};
+	return ok;
+}
+
+unsigned int TileHistograms::begin_index (const RunParameters &parameters, const string &filename, FILE *file) const
+{
+	FILE *previous = fopen (filename.c_str (), "rb");
+	unsigned int number_frames = 0;
+	ColumnTable::Signature signature;
+	bool ok =
+	      previous != NULL
+	      && this->read_header (previous, number_frames, signature)
+	      && number_frames <= parameters.number_frames
+	      && signature == parameters.cache_signature (filename, number_frames);
+	unsigned int result = 0;
+	if (ok && number_frames == parameters.number_frames)
+		result = number_frames;
+	else {
+		this->write_header (file, parameters.number_frames, parameters.cache_signature (filename));
+		if (ok) {
+			fprintf (stderr, "  extending histogram index %s from %u to %u frames\n", filename.c_str (), number_frames, parameters.number_frames);
+			// the tile histograms of the frames follow the header
+			char buffer [65536];
+			size_t count;
+			while ((count = fread (buffer, 1, sizeof (buffer), previous)) > 0)
+				fwrite (buffer, 1, count, file);
+			result = number_frames;
+		}
+	}
+	if (previous != NULL)
+		fclose (previous);
+	return result;
+}
+
+void TileHistograms::write (FILE *file)
+{
+	this->buffer.clear ();
+	for (unsigned int index_tile = 0; index_tile < this->columns * this->rows; index_tile++) {
+		const uint16_t *tile = &this->counts [index_tile * NUMBER_COLOUR_LEVELS];
+		unsigned int used_levels = 0;
+		for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+			if (tile [level] != 0)
+				used_levels++;
+		append_varint (this->buffer, used_levels);
+		unsigned int previous_level = 0;
+		for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+			if (tile [level] != 0) {
+				append_value (this->buffer, (uint8_t) (level - previous_level));
+				append_varint (this->buffer, tile [level]);
+				previous_level = level;
+			}
+	}
+	uint32_t size = this->buffer.size ();
+	fwrite (&size, sizeof (size), 1, file);
+	fwrite (this->buffer.data (), 1, size, file);
+}
+
+bool TileHistograms::read (FILE *file)
+{
+	uint32_t size;
+	if (fread (&size, sizeof (size), 1, file) != 1)
+		return false;
+	this->buffer.resize (size);
+	if (fread (this->buffer.data (), 1, size, file) != size)
+		return false;
+	fill (this->counts.begin (), this->counts.end (), 0);
+	size_t position = 0;
+	for (unsigned int index_tile = 0; index_tile < this->columns * this->rows; index_tile++) {
+		uint16_t *tile = &this->counts [index_tile * NUMBER_COLOUR_LEVELS];
+		unsigned int used_levels;
+		if (!extract_varint (this->buffer, position, used_levels) || used_levels > NUMBER_COLOUR_LEVELS)
+			return false;
+		unsigned int level = 0;
+		for (unsigned int index = 0; index < used_levels; index++) {
+			uint8_t delta;
+			unsigned int count;
+			if (!extract_value (this->buffer, position, delta) || !extract_varint (this->buffer, position, count))
+				return false;
+			level += delta;
+			if (level >= NUMBER_COLOUR_LEVELS)
+				return false;
+			tile [level] = count;
+		}
+	}
+	return true;
+}
+
+HistogramMatrix *read_histogram_index_rect (const RunParameters &parameters, const string &filename, int x1, int y1, int x2, int y2)
+{
+	FILE *file = fopen (filename.c_str (), "rb");
+	if (file == NULL)
+		return NULL;
+	TileHistograms tiles (HISTOGRAM_INDEX_TILE_SIZE, parameters.frame_size);
+	const cv::Rect inner = tiles.inner_rectangle (x1, y1, x2, y2);
+	const bool aligned = inner == cv::Rect (x1, y1, x2 - x1, y2 - y1);
+	if (!aligned && !parameters.frame_source ().mapped ()) {
+		fprintf (stderr, "  rectangle is not aligned with the tiles of histogram index %s, processing the video frames\n", filename.c_str ());
+		fclose (file);
+		return NULL;
+	}
+	fprintf (stderr, "  composing data from histogram index %s\n", filename.c_str ());
+	HistogramMatrix *result = new HistogramMatrix (parameters.number_frames);
+	Histogram histogram;
+	unsigned int number_frames;
+	ColumnTable::Signature signature;
+	bool ok =
+	      tiles.read_header (file, number_frames, signature)
+	      && number_frames == parameters.number_frames
+	      && signature == parameters.cache_signature (filename);
+	parameters.fold_frames ([&] (unsigned int index_frame) {
+		ok = ok && tiles.read (file);
+		if (ok) {
+			tiles.compose (inner, histogram);
+			if (!aligned)
+				add_border_pixels (read_frame (parameters, index_frame), x1, y1, x2, y2, inner, histogram);
+			result->set (index_frame, histogram);
+		}
+	});
+	fclose (file);
+	if (!ok) {
+		fprintf (stderr, "  histogram index %s does not match the video frames, ignoring it\n", filename.c_str ());
+		delete result;
+		return NULL;
+	}
+	return result;
+}
@@ -0,0 +1,66 @@
+#include <string.h>
+#include <algorithm>
+
+#include "histogram-matrix.hpp"
+#include "image.hpp"
+
+using namespace std;
+
+HistogramMatrix::HistogramMatrix (unsigned int number_frames):
+	counts ((size_t) number_frames * NUMBER_COLOUR_LEVELS, 0)
+{
+}
+
+unsigned int HistogramMatrix::number_frames () const
+{
+	return this->counts.size () / NUMBER_COLOUR_LEVELS;
+}
+
+const uint32_t *HistogramMatrix::frame (unsigned int index_frame) const
+{
+	return &this->counts [(size_t) (index_frame - 1) * NUMBER_COLOUR_LEVELS];
+}
+
+uint32_t *HistogramMatrix::frame (unsigned int index_frame)
+{
+	return &this->counts [(size_t) (index_frame - 1) * NUMBER_COLOUR_LEVELS];
+}
+
+void HistogramMatrix::set (unsigned int index_frame, const Histogram &histogram)
+{
+	uint32_t *counts = this->frame (index_frame);
+	for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+		counts [level] = histogram [level];
+}
+
+Histogram HistogramMatrix::histogram (unsigned int index_frame) const
+{
+	Histogram result;
+	const uint32_t *counts = this->frame (index_frame);
+	for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+		result [level] = counts [level];
+	return result;
+}
+
+int HistogramMatrix::most_common_colour (unsigned int index_frame) const
+{
+	const uint32_t *counts = this->frame (index_frame);
+	return max_element (counts, counts + NUMBER_COLOUR_LEVELS) - counts;
+}
+
+uint32_t HistogramMatrix::maximum () const
+{
+	if (this->counts.empty ())
+		return 0;
+	return *max_element (this->counts.begin (), this->counts.end ());
+}
+
+void HistogramMatrix::read (const ColumnTable &table, unsigned int number_rows)
+{
+	memcpy (this->counts.data (), table.row (0, 0), (size_t) number_rows * NUMBER_COLOUR_LEVELS * sizeof (uint32_t));
+}
+
+void HistogramMatrix::write_frame (ColumnTable &table, unsigned int index_frame) const
+{
+	memcpy (table.row (0, index_frame - 1), this->frame (index_frame), NUMBER_COLOUR_LEVELS * sizeof (uint32_t));
+}
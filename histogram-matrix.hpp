@@ -0,0 +1,53 @@
+#ifndef __HISTOGRAM_MATRIX__
+#define __HISTOGRAM_MATRIX__
+
+#include <stdint.h>
+#include <vector>
+
+#include "column-table.hpp"
+#include "histogram.hpp"
+
+/**
+ * @brief The HistogramMatrix class stores the histogram of every video frame
+ * in a single array of counts, one frame after the other.  A frame takes one
+ * kilobyte and scanning the frames reads memory sequentially.
+ *
+ * Frames start at one.  Frames that were not set have zero counts.
+ */
+class HistogramMatrix
+{
+	std::vector<uint32_t> counts;
+public:
+	HistogramMatrix (unsigned int number_frames);
+	unsigned int number_frames () const;
+	/**
+	 * @brief frame Return the counts of the given frame.
+	 */
+	const uint32_t *frame (unsigned int index_frame) const;
+	uint32_t *frame (unsigned int index_frame);
+	void set (unsigned int index_frame, const Histogram &histogram);
+	/**
+	 * @brief histogram Return the histogram of the given frame, in the type used
+	 * by the plots.
+	 */
+	Histogram histogram (unsigned int index_frame) const;
+	/**
+	 * @brief most_common_colour Return the most common colour of the given frame.
+	 */
+	int most_common_colour (unsigned int index_frame) const;
+	/**
+	 * @brief maximum Return the highest count of all frames.
+	 */
+	uint32_t maximum () const;
+	/**
+	 * Read the given number of rows, from the first, of a histogram cache table.
+	 */
+	void read (const ColumnTable &table, unsigned int number_rows);
+	/**
+	 * Write the histogram of the given frame to a row of a histogram cache
+	 * table.
+	 */
+	void write_frame (ColumnTable &table, unsigned int index_frame) const;
+};
+
+#endif
@@ -6,15 +6,18 @@ Histogram::Histogram ():
 {
 }
 
-void Histogram::read (FILE *file)
+bool Histogram::read (FILE *file)
 {
 	int value;
-	fscanf (file, "%d", &value);
+	if (fscanf (file, "%d", &value) != 1)
+		return false;
 	(*this) [0] = value;
 	for (unsigned int i = 1; i < NUMBER_COLOUR_LEVELS; i++) {
-		fscanf (file, ",%d", &value);
+		if (fscanf (file, ",%d", &value) != 1)
+			return false;
 		(*this) [i] = value;
 	}
+	return true;
 }
 
 void Histogram::write (FILE *file)
@@ -10,7 +10,11 @@ class Histogram:
 {
 public:
 	Histogram ();
-	void read (FILE *file);
+	/**
+	 * Read a line of comma separated values.
+	 * @return false if the file does not have all the values.
+	 */
+	bool read (FILE *file);
 	void write (FILE *file);
 	/**
 	 * Return the most common colour in this histogram.
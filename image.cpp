@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "frame-pool.hpp"
 #include "image.hpp"
 #include "util.hpp"
 
@@ -8,22 +9,15 @@ const unsigned int NUMBER_COLOUR_LEVELS = 256;
 
 void compute_histogram (const cv::Mat &image, Histogram &histogram)
 {
-	// Quantize the saturation to 32 levels
-	int sbins = NUMBER_COLOUR_LEVELS;
-	int histSize[] = {sbins};
-	// saturation varies from 0 (black-gray-white) to
-	// 255 (pure spectrum color)
-	float sranges[] = { 0, NUMBER_COLOUR_LEVELS };
-	const float* ranges[] = { sranges };
-	cv::MatND hist;
-	// we compute the histogram from the 0-th
-	int channels[] = {0};
-	cv::calcHist (&image, 1, channels, cv::Mat (), // do not use mask
-             hist, 1, histSize, ranges,
-             true, // the histogram is uniform
-             false);
+	// counting in place does not allocate the histogram of cv::calcHist
+	uint32_t counts [256] = {0};
+	for (int y = 0; y < image.rows; y++) {
+		const unsigned char *row = image.ptr<unsigned char> (y);
+		for (int x = 0; x < image.cols; x++)
+			counts [row [x]]++;
+	}
 	for (unsigned int i = 0; i < NUMBER_COLOUR_LEVELS; i++) {
-		histogram [i] = hist.at<float> (i);
+		histogram [i] = counts [i];
 	}
 }
 
@@ -36,82 +30,138 @@ void compute_histogram (const cv::Mat &image, int x1, int y1, int x2, int y2, Hi
 	compute_histogram (cropped, histogram);
 }
 
-void compute_pixel_count_difference (const Experiment &experiment, const cv::Mat &background, const cv::Mat &current_frame, FILE *file, std::queue<cv::Mat> *cache, std::vector<QVector<double> > *result)
+const Histogram &ImageScratch::difference_histogram (unsigned int index_other, unsigned int index_mask, unsigned int number_masks)
+{
+	const uint32_t *counts = &this->difference_counts [(index_other * number_masks + index_mask) * NUMBER_COLOUR_LEVELS];
+	for (unsigned int level = 0; level < NUMBER_COLOUR_LEVELS; level++)
+		this->histogram [level] = counts [level];
+	return this->histogram;
+}
+
+void compute_masked_difference_histograms (ImageScratch &scratch, const RegionMap &regions, const cv::Mat &frame, const std::vector<const cv::Mat *> &others)
 {
-	static Histogram histogram;
-	static cv::Mat number_bees, bee_speed, diff;
-	cv::absdiff (background, current_frame, number_bees);
-	bool enough_frames = cache->size () > experiment.parameters.delta_frame;
-	if (enough_frames) {
-		cv::Mat previous_frame = cache->front ();
-		cache->pop ();
-		cv::absdiff (previous_frame, current_frame, bee_speed);
+	const unsigned int number_regions = regions.number_regions ();
+	const unsigned int number_others = others.size ();
+	const unsigned int other_stride = number_regions * NUMBER_COLOUR_LEVELS;
+	std::vector<uint32_t> &difference_counts = scratch.difference_counts;
+	std::vector<const unsigned char *> &other_rows = scratch.other_rows;
+	difference_counts.assign (number_others * other_stride, 0);
+	other_rows.resize (number_others);
+	// a single pass over the spans reads each pixel of the frame once
+	for (unsigned int index_region = 0; index_region < number_regions; index_region++) {
+		uint32_t *counts = &difference_counts [index_region * NUMBER_COLOUR_LEVELS];
+		for (const RegionMap::Span &span : regions.spans (index_region)) {
+			const unsigned char *current = frame.ptr<unsigned char> (span.y);
+			for (unsigned int index_other = 0; index_other < number_others; index_other++)
+				other_rows [index_other] = others [index_other]->ptr<unsigned char> (span.y);
+			const unsigned char mask_value = span.mask_value;
+			for (int x = span.x1; x < span.x2; x++) {
+				const unsigned char pixel = current [x];
+				for (unsigned int index_other = 0; index_other < number_others; index_other++) {
+					const unsigned char other = other_rows [index_other][x];
+					unsigned char diff = pixel > other ? pixel - other : other - pixel;
+					counts [index_other * other_stride + (diff & mask_value)]++;
+				}
+			}
+		}
+		for (unsigned int index_other = 0; index_other < number_others; index_other++)
+			counts [index_other * other_stride] += regions.number_pixels_outside (index_region);
 	}
+}
+
+void compute_pixel_count_difference (ImageScratch &scratch, const Experiment &experiment, const cv::Mat &background, const cv::Mat &current_frame, FrameRing *ring, std::vector<QVector<double> > *result, DifferenceHistograms *difference_histograms)
+{
+	const unsigned int number_ROIs = experiment.parameters.number_ROIs;
+	std::vector<const cv::Mat *> &others = scratch.others;
+	others.clear ();
+	others.push_back (&background);
+	bool enough_frames = ring->available (experiment.parameters.delta_frame + 1);
+	if (enough_frames)
+		others.push_back (&ring->previous (experiment.parameters.delta_frame + 1));
+	compute_masked_difference_histograms (scratch, experiment.regions, current_frame, others);
+	if (difference_histograms != NULL)
+		difference_histograms->append_frame ();
 	int index_col = 0;
 	int value;
-	for (unsigned int index_mask = 0; index_mask < experiment.parameters.number_ROIs; index_mask++) {
-		if (index_mask > 0) fprintf (file, ",");
-		diff = number_bees & experiment.masks [index_mask];
-		compute_histogram (diff, histogram);
+	for (unsigned int index_mask = 0; index_mask < number_ROIs; index_mask++) {
+		const Histogram &histogram = scratch.difference_histogram (0, index_mask, number_ROIs);
+		if (difference_histograms != NULL)
+			difference_histograms->set (index_mask, DifferenceHistograms::BACKGROUND, histogram);
 		value = number_different_pixels (experiment.parameters, histogram);
 		(*result) [index_col++].append (value);
-		fprintf (file, "%d", value);
 		if (enough_frames) {
-			diff = bee_speed & experiment.masks [index_mask];
-			compute_histogram (diff, histogram);
+			const Histogram &histogram = scratch.difference_histogram (1, index_mask, number_ROIs);
+			if (difference_histograms != NULL)
+				difference_histograms->set (index_mask, DifferenceHistograms::PREVIOUS, histogram);
 			value = number_different_pixels (experiment.parameters, histogram);
 			(*result) [index_col++].append (value);
-			fprintf (file, ",%d", value);
 		}
-		else {
+		else
 			(*result) [index_col++].append (-1);
-			fprintf (file, ",-1");
-		}
 	}
-	cache->push (current_frame);
+	ring->push (current_frame);
 }
 
-cv::Mat light_calibrate (const Experiment &experiment, unsigned int index_frame)
+FrameRing::FrameRing (unsigned int capacity):
+	frames (capacity),
+	count (0)
 {
-	cv::Mat frame = read_frame (experiment.parameters, index_frame);
-	unsigned int pb = experiment.histogram_background_raw->most_common_colour ();
-	unsigned int pf = (*experiment.highest_colour_level_frames_rect) [index_frame - 1];
-	light_calibrate_method_PLSM (frame, pb, pf);
-	return frame;
 }
 
-cv::Mat light_calibrate (const Experiment &experiment, unsigned int index_frame, int x1, int y1, int x2, int y2, void (*method) (cv::Mat &, unsigned int, unsigned int))
+void FrameRing::push (const cv::Mat &frame)
 {
-	static Histogram histogram;
-	compute_histogram (experiment.background, x1, y1, x2, y2, histogram);
-	unsigned char pb = histogram.most_common_colour ();
-	cv::Mat frame = read_frame (experiment.parameters, index_frame);
-	compute_histogram (frame, x1, y1, x2, y2, histogram);
-	unsigned char pf = histogram.most_common_colour ();
-	method (frame, pb, pf);
-	return frame;
+	this->frames [this->count % this->frames.size ()] = frame;
+	this->count++;
 }
 
+bool FrameRing::available (unsigned int age) const
+{
+	return age >= 1 && age <= this->frames.size () && age <= this->count;
+}
 
-void light_calibrate_method_PLSM (cv::Mat &frame, unsigned int pb, unsigned int pf)
+const cv::Mat &FrameRing::previous (unsigned int age) const
 {
-	for(int i = 0; i < frame.rows; i++)
-		for(int j = 0; j < frame.cols; j++) {
-			unsigned char old_value = frame.at<unsigned char> (i, j);
-			if (old_value < pf)
-				frame.at<unsigned char> (i, j) = (unsigned int) ((float) (old_value * pb) / pf + 0.5);
-			else
-				frame.at<unsigned char> (i, j) = (unsigned int) (255 - ((float) (255 - old_value) * (255 - pb) / (255 - pf) + 0.5));
-		}
+	return this->frames [(this->count - age) % this->frames.size ()];
 }
 
-void light_calibrate_method_LC (cv::Mat &frame, unsigned int pb, unsigned int pf)
+void compute_difference_histograms_delta_frames (ImageScratch &scratch, const Experiment &experiment, const cv::Mat &background, const cv::Mat &current_frame, const std::vector<unsigned int> &delta_frames, FrameRing *ring, const std::vector<DifferenceHistograms *> &difference_histograms)
 {
-	for(int i = 0; i < frame.rows; i++)
-		for(int j = 0; j < frame.cols; j++) {
-			unsigned char old_value = frame.at<unsigned char> (i, j);
-			frame.at<unsigned char> (i, j) = std::min (
-			         (unsigned int) ((float) (old_value * pb) / pf + 0.5),
-			         NUMBER_COLOUR_LEVELS);
+	const unsigned int number_ROIs = experiment.parameters.number_ROIs;
+	// the difference to the background is the same for all frame gaps
+	std::vector<const cv::Mat *> &others = scratch.others;
+	others.clear ();
+	others.push_back (&background);
+	std::vector<unsigned int> index_others (delta_frames.size (), 0);
+	for (unsigned int index_delta = 0; index_delta < delta_frames.size (); index_delta++) {
+		unsigned int age = delta_frames [index_delta] + 1;
+		if (ring->available (age)) {
+			index_others [index_delta] = others.size ();
+			others.push_back (&ring->previous (age));
 		}
+	}
+	compute_masked_difference_histograms (scratch, experiment.regions, current_frame, others);
+	for (unsigned int index_delta = 0; index_delta < delta_frames.size (); index_delta++) {
+		DifferenceHistograms *histograms = difference_histograms [index_delta];
+		histograms->append_frame ();
+		for (unsigned int index_mask = 0; index_mask < number_ROIs; index_mask++) {
+			histograms->set (index_mask, DifferenceHistograms::BACKGROUND, scratch.difference_histogram (0, index_mask, number_ROIs));
+			if (index_others [index_delta] != 0)
+				histograms->set (index_mask, DifferenceHistograms::PREVIOUS, scratch.difference_histogram (index_others [index_delta], index_mask, number_ROIs));
+		}
+	}
+	ring->push (current_frame);
+}
+
+cv::Mat light_calibrate (ImageScratch &scratch, const Experiment &experiment, unsigned int index_frame, int x1, int y1, int x2, int y2, void (*method) (const cv::Mat &, cv::Mat &, unsigned int, unsigned int))
+{
+	Histogram &histogram = scratch.histogram;
+	compute_histogram (experiment.background, x1, y1, x2, y2, histogram);
+	unsigned char pb = histogram.most_common_colour ();
+	// the frame source may share its memory
+	cv::Mat frame = read_frame (experiment.parameters, index_frame);
+	cv::Mat result = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+	compute_histogram (frame, x1, y1, x2, y2, histogram);
+	unsigned char pf = histogram.most_common_colour ();
+	method (frame, result, pb, pf);
+	return result;
 }
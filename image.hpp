@@ -2,7 +2,7 @@
 #define __IMAGE__
 
 #include <unistd.h>
-#include <queue>
+#include <stdint.h>
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -11,6 +11,9 @@
 #include "experiment.hpp"
 #include "parameters.hpp"
 #include "histogram.hpp"
+#include "difference-histograms.hpp"
+#include "light-calibration.hpp"
+#include "region-map.hpp"
 
 extern const unsigned int NUMBER_COLOUR_LEVELS;
 
@@ -36,15 +39,48 @@ inline cv::Mat read_background (const RunParameters &parameters)
 }
 
 /**
- * Read the nth frame located in the folder parameter.
+ * Read the nth frame located in the folder parameter.  The frame may share
+ * memory with the frame source and must not be modified.
  */
 inline cv::Mat read_frame (const RunParameters &parameters, unsigned int index_frame)
 {
-	return cv::imread (parameters.frame_filename (index_frame), CV_LOAD_IMAGE_GRAYSCALE);
+	return parameters.frame_source ().read (index_frame);
 }
 
 /**
- * Compute the histogram of the given image.
+ * @brief The ImageScratch class holds the temporary data used by the image
+ * processing functions that work on whole frames.  Buffers are reused between
+ * calls.  Each thread that processes frames must use its own scratch.
+ */
+class ImageScratch
+{
+public:
+	Histogram histogram;
+	/**
+	 * Counts computed by compute_masked_difference_histograms.
+	 */
+	std::vector<uint32_t> difference_counts;
+	/**
+	 * Images compared with the frame, so that building the list does not
+	 * allocate for every frame.
+	 */
+	std::vector<const cv::Mat *> others;
+	/**
+	 * Rows of the other images in the span visited by
+	 * compute_masked_difference_histograms.
+	 */
+	std::vector<const unsigned char *> other_rows;
+	/**
+	 * @brief difference_histogram Copy one of the histograms computed by the
+	 * last call to compute_masked_difference_histograms to the histogram
+	 * attribute and return it.
+	 */
+	const Histogram &difference_histogram (unsigned int index_other, unsigned int index_mask, unsigned int number_masks);
+};
+
+/**
+ * Compute the histogram of the given image, which must have one channel of
+ * eight bits.  Nothing is allocated, so it needs no scratch.
  */
 void compute_histogram (const cv::Mat &image, Histogram &histogram);
 
@@ -53,21 +89,75 @@ void compute_histogram (const cv::Mat &image, Histogram &histogram);
  */
 void compute_histogram (const cv::Mat &image, int x1, int y1, int x2, int y2, Histogram &histogram);
 
+/**
+ * @brief compute_masked_difference_histograms Compute the histogram of the
+ * absolute difference between the frame and each of the other images,
+ * restricted to each region of interest.  Only the pixels in the spans of the
+ * regions are visited, and each pixel of the frame is read once for all the
+ * other images.  Like the expression absdiff (other, frame) & mask,
+ * pixels outside a region count as colour level zero.  Images must have one
+ * channel of eight bits and the size of the masks.
+ *
+ * The histograms are kept in the scratch and are retrieved with
+ * ImageScratch::difference_histogram.
+ */
+void compute_masked_difference_histograms (ImageScratch &scratch, const RegionMap &regions, const cv::Mat &frame, const std::vector<const cv::Mat *> &others);
+
+/**
+ * @brief The FrameRing class is a ring buffer with the most recent frames.
+ */
+class FrameRing
+{
+	std::vector<cv::Mat> frames;
+	unsigned long count;
+public:
+	FrameRing (unsigned int capacity);
+	unsigned int capacity () const
+	{
+		return this->frames.size ();
+	}
+	void push (const cv::Mat &frame);
+	/**
+	 * @brief available Return true if the frame pushed the given number of
+	 * pushes ago is in the ring.
+	 */
+	bool available (unsigned int age) const;
+	/**
+	 * @brief previous Return the frame pushed the given number of pushes ago.
+	 * The last pushed frame has age one.
+	 */
+	const cv::Mat &previous (unsigned int age) const;
+};
+
 /**
  * Compute pixel count difference between the given frame and the background
  * image and between the given frame and a frame x seconds afar.
  *
- * The pixel count difference data is stored in parameter result.
+ * The pixel count difference data is stored in parameter result.  If
+ * parameter difference_histograms is not NULL, the histograms of the
+ * differences in each region of interest are appended to it.  The ring must
+ * hold at least delta_frame plus one frames.  The current frame is pushed into
+ * the ring.
  */
-void compute_pixel_count_difference (const Experiment &experiment, const cv::Mat &background, const cv::Mat &frame, FILE *file, std::queue<cv::Mat> *cache, std::vector<QVector<double> > *result);
+void compute_pixel_count_difference (ImageScratch &scratch, const Experiment &experiment, const cv::Mat &background, const cv::Mat &frame, FrameRing *ring, std::vector<QVector<double> > *result, DifferenceHistograms *difference_histograms = NULL);
 
-cv::Mat light_calibrate (const Experiment &experiment, unsigned int frame);
+/**
+ * Compute the histograms of the difference between the given frame and the
+ * background image and between the given frame and frames afar, for several
+ * frame gaps.  The histograms are appended to the difference histograms of
+ * each frame gap.  Following the pixel count difference, a frame gap of d
+ * compares the frame with the frame d + 1 positions before it.  The ring must
+ * hold at least the largest gap plus one frames.  The current frame is pushed
+ * into the ring.
+ */
+void compute_difference_histograms_delta_frames (ImageScratch &scratch, const Experiment &experiment, const cv::Mat &background, const cv::Mat &frame, const std::vector<unsigned int> &delta_frames, FrameRing *ring, const std::vector<DifferenceHistograms *> &difference_histograms);
 
 /**
  * @brief light_calibrate Apply the given method to light calibrate a frame
  * based on the most common colour on a rectangular area of the background image
  * and the current frame.
  *
+ * @param scratch
  * @param experiment
  * @param index_frame
  * @param x1
@@ -76,10 +166,6 @@ cv::Mat light_calibrate (const Experiment &experiment, unsigned int frame);
  * @param y2
  * @return
  */
-cv::Mat light_calibrate (const Experiment &experiment, unsigned int index_frame, int x1, int y1, int x2, int y2, void (*method) (cv::Mat &, unsigned int, unsigned int));
-
-void light_calibrate_method_PLSM (cv::Mat &frame, unsigned int pb, unsigned int pf);
-
-void light_calibrate_method_LC (cv::Mat &frame, unsigned int pb, unsigned int pf);
+cv::Mat light_calibrate (ImageScratch &scratch, const Experiment &experiment, unsigned int index_frame, int x1, int y1, int x2, int y2, void (*method) (const cv::Mat &, cv::Mat &, unsigned int, unsigned int));
 
 #endif
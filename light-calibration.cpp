@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+#include "light-calibration.hpp"
+
+void light_calibration_table_method_PLSM (unsigned int pb, unsigned int pf, cv::Mat &table)
+{
+	table.create (1, LIGHT_CALIBRATION_TABLE_SIZE, CV_8U);
+	for (unsigned int level = 0; level < LIGHT_CALIBRATION_TABLE_SIZE; level++) {
+		unsigned char old_value = level;
+		if (old_value < pf)
+			table.at<unsigned char> (level) = (unsigned int) ((float) (old_value * pb) / pf + 0.5);
+		else if (pf < 255)
+			table.at<unsigned char> (level) = (unsigned int) (255 - ((float) (255 - old_value) * (255 - pb) / (255 - pf) + 0.5));
+		else
+			table.at<unsigned char> (level) = 255;
+	}
+}
+
+void light_calibration_table_method_LC (unsigned int pb, unsigned int pf, cv::Mat &table)
+{
+	table.create (1, LIGHT_CALIBRATION_TABLE_SIZE, CV_8U);
+	for (unsigned int level = 0; level < LIGHT_CALIBRATION_TABLE_SIZE; level++) {
+		unsigned char old_value = level;
+		if (pf == 0)
+			table.at<unsigned char> (level) = 0;
+		else
+			table.at<unsigned char> (level) = std::min (
+			         (unsigned int) ((float) (old_value * pb) / pf + 0.5),
+			         (unsigned int) LIGHT_CALIBRATION_TABLE_SIZE);
+	}
+}
+
+void light_calibrate_method_PLSM (cv::Mat &frame, unsigned int pb, unsigned int pf)
+{
+	light_calibrate_method_PLSM (frame, frame, pb, pf);
+}
+
+void light_calibrate_method_LC (cv::Mat &frame, unsigned int pb, unsigned int pf)
+{
+	light_calibrate_method_LC (frame, frame, pb, pf);
+}
+
+void light_calibrate_method_PLSM (const cv::Mat &frame, cv::Mat &result, unsigned int pb, unsigned int pf)
+{
+	static thread_local cv::Mat table;
+	light_calibration_table_method_PLSM (pb, pf, table);
+	cv::LUT (frame, table, result);
+}
+
+void light_calibrate_method_LC (const cv::Mat &frame, cv::Mat &result, unsigned int pb, unsigned int pf)
+{
+	static thread_local cv::Mat table;
+	light_calibration_table_method_LC (pb, pf, table);
+	cv::LUT (frame, table, result);
+}
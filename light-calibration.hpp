@@ -0,0 +1,47 @@
+#ifndef __LIGHT_CALIBRATION__
+#define __LIGHT_CALIBRATION__
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Number of entries of a light calibration lookup table, one per colour level
+ * of a frame with eight bits per pixel.
+ */
+#define LIGHT_CALIBRATION_TABLE_SIZE 256
+
+/**
+ * @brief light_calibration_table_method_PLSM Compute the lookup table that
+ * maps each colour level of a frame to its light calibrated colour level
+ * using the PLSM method.  The calibrated colour level only depends on the
+ * most common colour of the background, pb, and of the frame, pf.  When pf is
+ * 255, white maps to white instead of dividing by zero.
+ */
+void light_calibration_table_method_PLSM (unsigned int pb, unsigned int pf, cv::Mat &table);
+
+/**
+ * @brief light_calibration_table_method_LC Compute the lookup table of the LC
+ * light calibration method.  Levels scaled to 256 or more are clipped to 256,
+ * which wraps to zero in eight bits.  When pf is zero, every level maps to
+ * zero instead of dividing by zero.
+ *
+ * @see light_calibration_table_method_PLSM
+ */
+void light_calibration_table_method_LC (unsigned int pb, unsigned int pf, cv::Mat &table);
+
+/**
+ * Light calibrate a frame in place by applying the lookup table of the PLSM
+ * method.
+ */
+void light_calibrate_method_PLSM (cv::Mat &frame, unsigned int pb, unsigned int pf);
+
+void light_calibrate_method_LC (cv::Mat &frame, unsigned int pb, unsigned int pf);
+
+/**
+ * Light calibrate a frame with the PLSM method and write the result in the
+ * given image, which is reused if it has the size of the frame.
+ */
+void light_calibrate_method_PLSM (const cv::Mat &frame, cv::Mat &result, unsigned int pb, unsigned int pf);
+
+void light_calibrate_method_LC (const cv::Mat &frame, cv::Mat &result, unsigned int pb, unsigned int pf);
+
+#endif
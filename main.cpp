@@ -20,7 +20,7 @@ Parameters get_parameters (int argc, char *argv[])
 	if (user_parameters.number_frames == 0) {
 		DialogRunParameters dialog (NULL);
 		dialog.exec ();
-		UserParameters gui_parameters (dialog.get_folder (), dialog.get_frame_file_type (), dialog.get_number_ROIs ());
+		UserParameters gui_parameters (dialog.get_folder (), dialog.get_frame_file_type (), dialog.get_number_ROIs (), dialog.get_video_filename ());
 		if (gui_parameters.number_frames == 0) {
 			fprintf (stderr, "There are no video frames to analyse!\n");
 			exit (EXIT_FAILURE);
@@ -39,6 +39,10 @@ int main (int argc, char **argv)
 	init ();
 	QApplication a (argc, argv);
 	UserParameters parameters = get_parameters (argc, argv);
+	if (parameters.sharded ()) {
+		fprintf (stderr, "Frame ranges are only processed by the batch tool!\n");
+		exit (EXIT_FAILURE);
+	}
 	Experiment experiment (parameters);
 	VideoAnalyser video_analyser (experiment);
 	video_analyser.show ();
@@ -1,6 +1,10 @@
+#include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
 #include <unistd.h>
+#include <algorithm>
 #include <limits>
+#include <thread>
 
 #include "parameters.hpp"
 #include "process-image.hpp"
@@ -9,6 +13,8 @@
 using namespace std;
 
 static string verify_slash_at_end (const string &folder);
+static unsigned int parse_unsigned (const char *option, const char *text);
+static vector<unsigned int> parse_unsigned_list (const char *option, const char *text);
 
 UserParameters::UserParameters ():
    RunParameters (
@@ -20,16 +26,60 @@ UserParameters::UserParameters ():
 {
 }
 
-RunParameters::RunParameters (const string &folder, const string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame):
+RunParameters::RunParameters (const string &folder, const string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame, const string &video_filename, const string &frame_name_template, bool verify_frames):
+	manifest (new FrameManifest (folder + verify_slash_at_end (folder), frame_name_template, frame_file_type, verify_frames)),
+	source (FrameSource::create (*manifest, video_filename)),
    folder (folder + verify_slash_at_end (folder)),
 	frame_file_type (frame_file_type),
+	frame_name_template (frame_name_template),
+	video_filename (video_filename),
 	number_ROIs (number_ROIs),
 	delta_frame (delta_frame),
-	number_frames (compute_number_frames ()),
-	frame_size (compute_frame_size ())
+	number_frames (source->number_frames ()),
+	frame_size (manifest->frame_size ()),
+	number_threads (max (1u, thread::hardware_concurrency ())),
+	pixel_count_difference_chunk_size (0),
+	readahead_depth (4 * number_threads),
+	checkpoint_interval (1000),
+	frame_range_first (1),
+	frame_range_last (0)
 {
 }
 
+ColumnTable::Signature RunParameters::cache_signature (const string &filename, unsigned int number_frames) const
+{
+	string description =
+	      filename.substr (filename.rfind ('/') + 1) + "\n" +
+	      this->frame_file_type + "\n" +
+	      this->frame_name_template + "\n" +
+	      this->video_filename + "\n" +
+	      to_string (this->number_ROIs) + " " + to_string (this->frame_size.width) + "x" + to_string (this->frame_size.height);
+	uint64_t result = FrameManifest::hash_data (description.data (), description.size ());
+	for (unsigned int index_mask = 0; index_mask < this->number_ROIs; index_mask++) {
+		uint64_t hash = FrameManifest::hash_file (this->mask_filename (index_mask));
+		result = FrameManifest::hash_data (&hash, sizeof (hash), result);
+	}
+	// frames decoded from a video or packed in a single file are not in the
+	// frame manifest, the file identifies them
+	string frames_filename = this->source->frames_filename ();
+	if (!frames_filename.empty ()) {
+		FrameManifest::Entry frames_file;
+		FrameManifest::stat_file (frames_filename, frames_file);
+		return ColumnTable::Signature {result, this->manifest->contents_hash (number_frames, frames_file)};
+	}
+	return ColumnTable::Signature {result, this->manifest->contents_hash (number_frames)};
+}
+
+bool RunParameters::update_frames ()
+{
+	if (!this->video_filename.empty () || !this->manifest->update ())
+		return false;
+	this->source.reset (FrameSource::create (*this->manifest, this->video_filename));
+	unsigned int number_frames = this->number_frames;
+	this->number_frames = this->source->number_frames ();
+	return this->number_frames > number_frames;
+}
+
 UserParameters UserParameters::parse (int argc, char *argv[])
 {
 	bool ok = true;
@@ -38,6 +88,19 @@ UserParameters UserParameters::parse (int argc, char *argv[])
 	unsigned int same_colour_threshold = 15;
 	unsigned int delta_frame = 2;
 	unsigned int number_ROIs = 3;
+	unsigned int number_threads = 0;
+	unsigned int chunk_size = 0;
+	unsigned int readahead_depth = 0;
+	unsigned int checkpoint_interval = 0;
+	vector<unsigned int> delta_frames;
+	const char *video_filename = "";
+	const char *frame_name_template = DEFAULT_FRAME_NAME_TEMPLATE;
+	bool pack_frames = false;
+	bool verify_frames = false;
+	unsigned int frame_range[2] = {1, 0};
+	int rectangle[4];
+	bool has_rectangle = false;
+	char rest;
 	do {
 		static struct option long_options[] = {
 			{"folder"                , required_argument, 0, 'p' },
@@ -45,19 +108,29 @@ UserParameters UserParameters::parse (int argc, char *argv[])
 			{"same-colour-threshold" , required_argument, 0, 'c' },
 			{"delta-frame"           , required_argument, 0, 'd'},
 		   {"number-ROIs"           , required_argument, 0, 'r'},
+		   {"threads"               , required_argument, 0, 't'},
+		   {"chunk-size"            , required_argument, 0, 'k'},
+		   {"delta-frames"          , required_argument, 0, 'D'},
+		   {"video"                 , required_argument, 0, 'v'},
+		   {"pack-frames"           , no_argument      , 0, 'P'},
+		   {"readahead"             , required_argument, 0, 'a'},
+		   {"frame-name"            , required_argument, 0, 'n'},
+		   {"checkpoint"            , required_argument, 0, 'K'},
+		   {"rectangle"             , required_argument, 0, 'R'},
+		   {"frame-range"           , required_argument, 0, 'F'},
+		   {"verify-frames"         , no_argument      , 0, 'V'},
 		   {0,         0,                 0,  0 }
 		};
-		int c = getopt_long (argc, argv, "p:f:c:r:d:", long_options, 0);
+		int c = getopt_long (argc, argv, "p:f:c:r:d:t:k:D:v:Pa:n:K:R:F:V", long_options, 0);
 		switch (c) {
 		case '?':
+		case ':':
+			// getopt_long has printed the unknown option or missing argument
+			exit (PARAMETERS_USAGE_ERROR);
 			break;
 		case -1:
 			ok = false;
 			break;
-		case ':':
-			fprintf (stderr, "Missing argument\n");
-			exit (EXIT_FAILURE);
-			break;
 		case 'p':
 			folder = optarg;
 			break;
@@ -65,43 +138,97 @@ UserParameters UserParameters::parse (int argc, char *argv[])
 			frame_file_type = optarg;
 			break;
 		case 'c':
-			same_colour_threshold = (unsigned int) atoi (optarg);
+			same_colour_threshold = parse_unsigned ("same-colour-threshold", optarg);
 			break;
 		case 'd':
-			delta_frame = (unsigned int) atoi (optarg);
+			delta_frame = parse_unsigned ("delta-frame", optarg);
 			break;
 		case 'r':
-			number_ROIs = (unsigned int) atoi (optarg);
+			number_ROIs = parse_unsigned ("number-ROIs", optarg);
+			break;
+		case 't':
+			number_threads = parse_unsigned ("threads", optarg);
+			break;
+		case 'k':
+			chunk_size = parse_unsigned ("chunk-size", optarg);
+			break;
+		case 'D':
+			delta_frames = parse_unsigned_list ("delta-frames", optarg);
+			break;
+		case 'v':
+			video_filename = optarg;
+			break;
+		case 'P':
+			pack_frames = true;
+			break;
+		case 'V':
+			verify_frames = true;
+			break;
+		case 'a':
+			readahead_depth = parse_unsigned ("readahead", optarg);
+			break;
+		case 'n':
+			frame_name_template = optarg;
+			break;
+		case 'K':
+			checkpoint_interval = parse_unsigned ("checkpoint", optarg);
+			break;
+		case 'R':
+			if (sscanf (optarg, "%d,%d,%d,%d%c", &rectangle [0], &rectangle [1], &rectangle [2], &rectangle [3], &rest) != 4) {
+				fprintf (stderr, "Invalid rectangle %s, expected X1,Y1,X2,Y2\n", optarg);
+				exit (PARAMETERS_USAGE_ERROR);
+			}
+			has_rectangle = true;
+			break;
+		case 'F':
+			if (sscanf (optarg, "%u:%u", &frame_range [0], &frame_range [1]) != 2 || frame_range [0] < 1 || frame_range [1] < frame_range [0]) {
+				fprintf (stderr, "Invalid frame range %s, expected START:END\n", optarg);
+				exit (PARAMETERS_USAGE_ERROR);
+			}
+			break;
 		}
 	} while (ok);
-	return UserParameters (folder, frame_file_type, number_ROIs, delta_frame, same_colour_threshold);
-}
-
-unsigned int RunParameters::compute_number_frames () const
-{
-	unsigned int low, high;
-	high = 1;
-	while (access (this->frame_filename (high).c_str (), F_OK) == 0)
-		high = 2 * high;
-	low = high / 2;
-	if (low > 0)
-		while (low < high) {
-			unsigned int middle = (low + high) / 2;
-			if (access (this->frame_filename (middle).c_str (), F_OK) == 0)
-				low = middle + 1;
-			else
-				high = middle - 1;
+	if (pack_frames)
+		RawFrameSource::pack (folder + verify_slash_at_end (folder), frame_name_template, frame_file_type, video_filename, number_threads > 0 ? number_threads : max (1u, thread::hardware_concurrency ()));
+	UserParameters result (folder, frame_file_type, number_ROIs, delta_frame, same_colour_threshold, video_filename, frame_name_template, verify_frames);
+	if (number_threads > 0)
+		result.number_threads = number_threads;
+	result.pixel_count_difference_chunk_size = chunk_size;
+	result.readahead_depth = readahead_depth > 0 ? readahead_depth : 4 * result.number_threads;
+	if (checkpoint_interval > 0)
+		result.checkpoint_interval = checkpoint_interval;
+	result.frame_range_first = frame_range [0];
+	result.frame_range_last = frame_range [1];
+	if (has_rectangle) {
+		// the rectangle crops the frames, whose size is known once the frame
+		// manifest is read
+		if (rectangle [0] < 0 || rectangle [0] >= rectangle [2] || rectangle [1] < 0 || rectangle [1] >= rectangle [3]
+		    || (result.frame_size.area () > 0 && (rectangle [2] > result.frame_size.width || rectangle [3] > result.frame_size.height))) {
+			fprintf (stderr, "Invalid rectangle %d,%d,%d,%d, expected 0 <= X1 < X2 <= %d and 0 <= Y1 < Y2 <= %d\n",
+			         rectangle [0], rectangle [1], rectangle [2], rectangle [3], result.frame_size.width, result.frame_size.height);
+			exit (PARAMETERS_USAGE_ERROR);
 		}
-	return low;
-}
-
-cv::Size RunParameters::compute_frame_size () const
-{
-	return read_background (*this).size ();
+		result.x1 = rectangle [0];
+		result.y1 = rectangle [1];
+		result.x2 = rectangle [2];
+		result.y2 = rectangle [3];
+	}
+	// a gap keeps that many frames in memory
+	for (unsigned int a_delta_frame : delta_frames)
+		if (result.number_frames > 0 && a_delta_frame >= result.number_frames) {
+			fprintf (stderr, "Invalid frame gap %u of option --delta-frames, there are %u video frames\n", a_delta_frame, result.number_frames);
+			exit (PARAMETERS_USAGE_ERROR);
+		}
+	sort (delta_frames.begin (), delta_frames.end ());
+	for (unsigned int a_delta_frame : delta_frames)
+		if (a_delta_frame != result.delta_frame &&
+		    (result.extra_delta_frames.empty () || result.extra_delta_frames.back () != a_delta_frame))
+			result.extra_delta_frames.push_back (a_delta_frame);
+	return result;
 }
 
-UserParameters::UserParameters (const string &folder, const string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame, unsigned int same_colour_threshold):
-   RunParameters (folder, frame_file_type, number_ROIs, delta_frame),
+UserParameters::UserParameters (const string &folder, const string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame, unsigned int same_colour_threshold, const string &video_filename, const string &frame_name_template, bool verify_frames):
+   RunParameters (folder, frame_file_type, number_ROIs, delta_frame, video_filename, frame_name_template, verify_frames),
    same_colour_threshold (same_colour_threshold),
    same_colour_level (round ((NUMBER_COLOUR_LEVELS * same_colour_threshold) / 100.0)),
    x1 (numeric_limits<int>::max ()),
@@ -111,8 +238,8 @@ UserParameters::UserParameters (const string &folder, const string &frame_file_t
 {
 }
 
-UserParameters::UserParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs):
-   UserParameters (folder, frame_file_type, number_ROIs, 2, 15)
+UserParameters::UserParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs, const std::string &video_filename, const std::string &frame_name_template):
+   UserParameters (folder, frame_file_type, number_ROIs, 2, 15, video_filename, frame_name_template)
 {
 }
 
@@ -141,3 +268,37 @@ static string verify_slash_at_end (const string &folder)
 	else
 		return "/";
 }
+
+/**
+ * Parse the unsigned integer value of an option.
+ */
+static unsigned int parse_unsigned (const char *option, const char *text)
+{
+	char *end;
+	errno = 0;
+	unsigned long result = strtoul (text, &end, 10);
+	if (!isdigit ((unsigned char) *text) || *end != 0 || errno != 0 || result > numeric_limits<unsigned int>::max ()) {
+		fprintf (stderr, "Invalid value %s of option --%s, expected an unsigned integer\n", text, option);
+		exit (PARAMETERS_USAGE_ERROR);
+	}
+	return result;
+}
+
+/**
+ * Parse the comma separated list of unsigned integers that is the value of an
+ * option.
+ */
+static vector<unsigned int> parse_unsigned_list (const char *option, const char *text)
+{
+	vector<unsigned int> result;
+	string rest (text);
+	size_t position = 0;
+	for (;;) {
+		size_t comma = rest.find (',', position);
+		result.push_back (parse_unsigned (option, rest.substr (position, comma - position).c_str ()));
+		if (comma == string::npos)
+			break;
+		position = comma + 1;
+	}
+	return result;
+}
@@ -2,154 +2,214 @@
 #define __PARAMETERS__
 
 #include <stdio.h>
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <vector>
 #include <opencv2/core/core.hpp>
 
+#include "column-table.hpp"
+#include "frame-executor.hpp"
+#include "frame-source.hpp"
+#include "histogram-index.hpp"
+
+/**
+ * Exit status when the command line options are not valid.
+ */
+#define PARAMETERS_USAGE_ERROR 2
+
+/**
+ * Text between the name of a cache table and the frame range of a shard of it.
+ */
+#define SHARD_FILENAME_INFIX ".shard="
+
 /**
  * @brief The RunParameters class represents parameters used to perform an experimental run.
  */
 class RunParameters
 {
-	unsigned int compute_number_frames () const;
-	cv::Size compute_frame_size () const;
+	/**
+	 * Shared by the copies of these parameters.
+	 */
+	std::shared_ptr<FrameManifest> manifest;
+	std::shared_ptr<FrameSource> source;
 public:
 	const std::string folder;
 	const std::string frame_file_type;
+	/**
+	 * @brief frame_name_template Template of the names of the frames
+	 * extracted in the folder.
+	 * @see FrameNaming
+	 */
+	const std::string frame_name_template;
+	/**
+	 * @brief video_filename If not empty, frames are decoded from this video
+	 * file instead of being read from the frames extracted in the folder.
+	 */
+	const std::string video_filename;
 	const unsigned int number_ROIs;
 	const unsigned int delta_frame;
-	const unsigned int number_frames;
+	/**
+	 * @brief number_frames Number of video frames.  It grows when frames are
+	 * added to the folder.
+	 * @see update_frames
+	 */
+	unsigned int number_frames;
 	const cv::Size frame_size;
-	RunParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame);
-	std::string background_filename () const
+	/**
+	 * @brief number_threads Number of threads used to process video frames.
+	 */
+	unsigned int number_threads;
+	/**
+	 * @brief pixel_count_difference_chunk_size If non zero, the pixel count
+	 * difference is computed in chunks of this many frames that are processed
+	 * in parallel.  Each chunk primes its window of previous frames with the
+	 * frames before its start.
+	 */
+	unsigned int pixel_count_difference_chunk_size;
+	/**
+	 * @brief readahead_depth Maximum number of video frames that are decoded
+	 * ahead of the frame being processed in a pass over all the frames.
+	 */
+	unsigned int readahead_depth;
+	/**
+	 * @brief checkpoint_interval Number of video frames after which the
+	 * cache tables being written are flushed to disk, so that an interrupted
+	 * run resumes from there.
+	 */
+	unsigned int checkpoint_interval;
+	/**
+	 * @brief frame_range_first First video frame of the shard processed by
+	 * this run.  Runs that process shards of the video frames write their
+	 * cache tables to shard files that are merged afterwards.
+	 */
+	unsigned int frame_range_first;
+	/**
+	 * @brief frame_range_last Last video frame of the shard processed by this
+	 * run, or zero for the last video frame.
+	 */
+	unsigned int frame_range_last;
+	/**
+	 * @param verify_frames Check every frame listed in the frame manifest
+	 * instead of a sample of them.
+	 */
+	RunParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame, const std::string &video_filename = "", const std::string &frame_name_template = DEFAULT_FRAME_NAME_TEMPLATE, bool verify_frames = false);
+	FrameSource &frame_source () const
 	{
-		return folder + "background." + frame_file_type;
+		return *this->source;
 	}
-	std::string frame_filename (int index_frame) const
+	unsigned int shard_first_frame () const
 	{
-		std::string result = this->folder + "frames-";
-		char number[5];
-		sprintf (number, "%04d", index_frame);
-		result += number;
-		result += ".";
-		result += this->frame_file_type;
-		return result;
+		return std::max (1u, this->frame_range_first);
 	}
-	std::string mask_filename (int index_mask) const
+	unsigned int shard_last_frame () const
 	{
-		return this->folder + "Mask-" + std::to_string (index_mask + 1) + ".png";
+		return this->frame_range_last == 0 ? this->number_frames : std::min (this->frame_range_last, this->number_frames);
 	}
-	std::string histogram_background_filename () const
+	/**
+	 * @brief sharded Return whether this run only processes a shard of the
+	 * video frames.
+	 */
+	bool sharded () const
 	{
-		return this->folder + "histogram-background.csv";
+		return this->shard_first_frame () > 1 || this->shard_last_frame () < this->number_frames;
 	}
-	std::string histogram_frames_all_filename () const
+	/**
+	 * @brief shard_filename Return the name of the file where a run that
+	 * processes the given shard of the video frames writes a cache table.
+	 */
+	static std::string shard_filename (const std::string &filename, unsigned int first_frame, unsigned int last_frame)
 	{
-		return this->folder + "histogram-frames-all.csv";
+		return filename + SHARD_FILENAME_INFIX + std::to_string (first_frame) + "-" + std::to_string (last_frame);
 	}
-	void fold0_frames_IF (void (*func) (unsigned int, const std::string &)) const
+	std::string shard_filename (const std::string &filename) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (index_frame, frame_filename);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return this->sharded () ? shard_filename (filename, this->shard_first_frame (), this->shard_last_frame ()) : filename;
 	}
-	template<typename A> void fold1_frames_IF (void (*func) (unsigned int, const std::string &, A *), A *acc1) const
+	std::string background_filename () const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (index_frame, frame_filename, acc1);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return folder + "background." + frame_file_type;
 	}
-	template<typename A, typename B> void fold2_frames_V (void (*func) (A *, B *), A *acc1, B *acc2) const
+	std::string frame_filename (unsigned int index_frame) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			func (acc1, acc2);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return this->manifest->get_naming ().filename (this->folder, index_frame);
 	}
-	template<typename A, typename B> void fold2_frames_IF (void (*func) (unsigned int, const std::string &, A *, B *), A *acc1, B *acc2) const
+	/**
+	 * @brief cache_signature Return the signature of the data in the given
+	 * cache table: the name of the cache, which has the parameters of the
+	 * feature, the masks of the regions of interest and the contents of the
+	 * video frames.
+	 */
+	ColumnTable::Signature cache_signature (const std::string &filename) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (index_frame, frame_filename, acc1, acc2);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return this->cache_signature (filename, this->number_frames);
 	}
-	template<typename A, typename B> void fold2_frames_I (void (*func) (unsigned int, A *, B *), A *acc1, B *acc2) const
+	/**
+	 * @brief cache_signature Return the signature of the data in the given
+	 * cache table for the given number of frames from the first.
+	 */
+	ColumnTable::Signature cache_signature (const std::string &filename, unsigned int number_frames) const;
+	/**
+	 * @brief update_frames Pick up the frames extracted to the folder after
+	 * the last one.  Frames decoded from a video or packed in a single file
+	 * are fixed.
+	 * @return true if there are new frames.
+	 */
+	bool update_frames ();
+	std::string mask_filename (int index_mask) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			func (index_frame, acc1, acc2);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return this->folder + "Mask-" + std::to_string (index_mask + 1) + ".png";
 	}
-	template<typename A, typename B, typename C> void fold3_frames_I (void (*func) (unsigned int, A, B, C), A acc1, B acc2, C acc3) const
+	std::string histogram_background_filename () const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			func (index_frame, acc1, acc2, acc3);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return this->folder + "histogram-background.csv";
 	}
-	template<typename A, typename B, typename C> void fold3_frames_V (void (*func) (A *, B *, C), A *acc1, B *acc2, C acc3) const
+	std::string histogram_frames_all_filename () const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			func (acc1, acc2, acc3);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		return this->folder + "histogram-frames-all.bin";
 	}
-	template<typename A, typename B, typename C> void fold3_frames_IF (void (*func) (unsigned int, const std::string &, A, B, C), A acc1, B acc2, C acc3) const
+	/**
+	 * @brief fold_frames Call the given function with the index of every video
+	 * frame, in order, on the calling thread.
+	 */
+	template<typename F> void fold_frames (F func) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (index_frame, frame_filename, acc1, acc2, acc3);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		this->fold_frames (1, func);
 	}
-	template<typename A, typename B, typename C, typename D> void fold4_frames_IF (void (*func) (unsigned int, const std::string &, A, B, C, D), A acc1, B acc2, C acc3, D acc4) const
+	/**
+	 * @brief fold_frames Call the given function with the index of every video
+	 * frame from the given one, in order, on the calling thread.
+	 */
+	template<typename F> void fold_frames (unsigned int first_frame, F func) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (index_frame, frame_filename, acc1, acc2, acc3, acc4);
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
+		this->fold_frames (first_frame, this->number_frames, func);
 	}
-	template<typename A, typename B, typename C, typename D> void fold4_frames_F (void (*func) (const std::string &, A, B, C, D), A acc1, B acc2, C acc3, D acc4) const
+	/**
+	 * @brief fold_frames Call the given function with the index of every video
+	 * frame in the given closed range, in order, on the calling thread.
+	 */
+	template<typename F> void fold_frames (unsigned int first_frame, unsigned int last_frame, F func) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (frame_filename, acc1, acc2, acc3, acc4);
+		for (unsigned int index_frame = first_frame; index_frame <= last_frame; index_frame++) {
+			func (index_frame);
 			fprintf (stderr, "\r    %d", index_frame);
 			fflush (stderr);
 		}
 		fprintf (stderr, "\n");
 	}
-	template<typename A, typename B, typename C, typename D, typename E> void fold5_frames_F (void (*func) (const std::string &, A, B, C, D, E), A acc1, B acc2, C acc3, D acc4, E acc5) const
+	/**
+	 * @brief parallel_fold_frames Apply function map to the index of every
+	 * video frame using a pool of #number_threads threads.  The results are
+	 * passed to function consume in frame order on the calling thread, so
+	 * consume can write cache files.
+	 */
+	template<typename R, typename M, typename C> void parallel_fold_frames (M map, C consume) const
 	{
-		for (unsigned int index_frame = 1; index_frame <= this->number_frames; index_frame++) {
-			std::string frame_filename = this->frame_filename (index_frame);
-			func (frame_filename, acc1, acc2, acc3, acc4, acc5);
+		parallel_ordered<R> (this->number_threads, 1, this->number_frames, map, [&] (unsigned int index_frame, R &value) {
+			consume (index_frame, value);
 			fprintf (stderr, "\r    %d", index_frame);
 			fflush (stderr);
-		}
+		});
 		fprintf (stderr, "\n");
 	}
 };
@@ -166,7 +226,7 @@ class UserParameters: public RunParameters
 		      std::to_string (this->x1) + "x" + std::to_string (this->y1) + "-" +
 		      std::to_string (this->x2) + "x" + std::to_string (this->y2);
 	}
-	UserParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame, unsigned int same_colour_threshold);
+	UserParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs, unsigned int delta_frame, unsigned int same_colour_threshold, const std::string &video_filename, const std::string &frame_name_template, bool verify_frames = false);
 	unsigned int same_colour_threshold;
 	unsigned int same_colour_level;
 public:
@@ -177,17 +237,31 @@ public:
 	int y1;
 	int x2;
 	int y2;
+	/**
+	 * @brief extra_delta_frames Other frame gaps for which bee speed is
+	 * computed in the same pass as the pixel count difference with
+	 * #delta_frame.  The gaps are sorted and do not contain #delta_frame.
+	 */
+	std::vector<unsigned int> extra_delta_frames;
 	UserParameters ();
-	UserParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs);
+	UserParameters (const std::string &folder, const std::string &frame_file_type, unsigned int number_ROIs, const std::string &video_filename = "", const std::string &frame_name_template = DEFAULT_FRAME_NAME_TEMPLATE);
+	/**
+	 * @brief parse Parse the command line options.  Exits with
+	 * #PARAMETERS_USAGE_ERROR if an option is unknown or has an invalid value.
+	 */
 	static UserParameters parse (int argc, char *argv[]);
 	std::string features_pixel_count_difference_raw_filename () const
+	{
+		return this->features_pixel_count_difference_raw_filename (this->delta_frame);
+	}
+	std::string features_pixel_count_difference_raw_filename (unsigned int delta_frame) const
 	{
 		return
 		      this->folder +
 		      "features-pixel-count-difference"
 		      "_SCT=" + std::to_string (this->same_colour_threshold) +
-		      "_DF=" + std::to_string (this->delta_frame) +
-		      "_raw.csv";
+		      "_DF=" + std::to_string (delta_frame) +
+		      "_raw.bin";
 	}
 	std::string features_pixel_count_difference_histogram_equalization_filename () const
 	{
@@ -196,14 +270,63 @@ public:
 		      "features-pixel-count-difference"
 		      "_SCT=" + std::to_string (this->same_colour_threshold) +
 		      "_DF=" + std::to_string (this->delta_frame) +
-		      "_histogram-equalization.csv";
+		      "_histogram-equalization.bin";
+	}
+	std::string difference_histograms_raw_filename () const
+	{
+		return this->difference_histograms_raw_filename (this->delta_frame);
+	}
+	std::string difference_histograms_raw_filename (unsigned int delta_frame) const
+	{
+		return
+		      this->folder +
+		      "difference-histograms"
+		      "_DF=" + std::to_string (delta_frame) +
+		      "_raw.bin";
+	}
+	std::string difference_histograms_histogram_equalization_filename () const
+	{
+		return
+		      this->folder +
+		      "difference-histograms"
+		      "_DF=" + std::to_string (this->delta_frame) +
+		      "_histogram-equalization.bin";
+	}
+	std::string difference_histograms_light_calibrated_most_common_colour_filename_method_PLSM () const
+	{
+		return
+		      this->folder +
+		      "difference-histograms"
+		      "_DF=" + std::to_string (this->delta_frame) +
+		      "_light-calibration-most-common-colour" +
+		      rectangle () +
+		      "_PLSM" +
+		      ".bin";
+	}
+	std::string difference_histograms_light_calibrated_most_common_colour_filename_method_LC () const
+	{
+		return
+		      this->folder +
+		      "difference-histograms"
+		      "_DF=" + std::to_string (this->delta_frame) +
+		      "_light-calibration-most-common-colour" +
+		      rectangle () +
+		      "_LC" +
+		      ".bin";
 	}
 	std::string histogram_frames_rect () const
 	{
 		return this->folder +
 		       "histogram-frames-rect-" +
 		       this->rectangle () +
-		       ".csv";
+		       ".bin";
+	}
+	std::string histogram_index_filename () const
+	{
+		return this->folder +
+		       "histogram-index"
+		       "_TS=" + std::to_string (HISTOGRAM_INDEX_TILE_SIZE) +
+		       ".bin";
 	}
 	std::string histogram_frames_light_calibrated_most_common_colour_method_PLSM_filename () const
 	{
@@ -213,7 +336,7 @@ public:
 		      "_light-calibrated-most-common-colour" +
 		      this->rectangle () +
 		      "_PLSM"
-		      ".csv";
+		      ".bin";
 	}
 	std::string histogram_frames_light_calibrated_most_common_colour_method_LC_filename () const
 	{
@@ -223,7 +346,7 @@ public:
 		      "_light-calibrated-most-common-colour" +
 		      this->rectangle () +
 		      "_LC"
-		      ".csv";
+		      ".bin";
 	}
 	std::string features_pixel_count_difference_light_calibrated_most_common_colour_filename_method_PLSM () const
 	{
@@ -235,7 +358,7 @@ public:
 		      "_light-calibration-most-common-colour" +
 		      rectangle () +
 		      "_PLSM" +
-		      ".csv";
+		      ".bin";
 	}
 	std::string features_pixel_count_difference_light_calibrated_most_common_colour_filename_method_LC () const
 	{
@@ -247,7 +370,7 @@ public:
 		      "_light-calibration-most-common-colour" +
 		      rectangle () +
 		      "_LC" +
-		      ".csv";
+		      ".bin";
 	}
 	std::string highest_colour_level_frames_rect_filename () const
 	{
@@ -255,7 +378,7 @@ public:
 		      this->folder +
 		      "most-common-colour" +
 		      rectangle () +
-		      ".csv";
+		      ".bin";
 	}
 	/**
 	 * @brief rectangle_user return a string representing the rectangle to be analysed in a human readable way.
@@ -267,6 +390,13 @@ public:
 		    "(" + std::to_string (this->x1) + "," + std::to_string (this->y1) + ")-(" +
 		    std::to_string (this->x2) + "," + std::to_string (this->y2) + ")";
 	}
+	/**
+	 * @brief has_rectangle return whether the rectangle to be analysed was set.
+	 */
+	bool has_rectangle () const
+	{
+		return this->x1 < this->x2 && this->y1 < this->y2;
+	}
 	unsigned int get_same_colour_threshold () const;
 	void set_same_colour_threshold (unsigned int value);
 	unsigned int get_same_colour_level() const;
@@ -1,60 +1,404 @@
 #include <unistd.h>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 
 #include "image.hpp"
 #include "process-image.hpp"
+#include "feature-engine.hpp"
+#include "frame-pool.hpp"
+#include "difference-histograms.hpp"
 #include "util.hpp"
 
 using namespace std;
 
-static map<int, Histogram> *read_histograms_frames (const RunParameters &parameters, const string &filename);
-static void read_pixel_count_difference (const RunParameters &parameters, const string &filename, vector<QVector<double> > *data);
+static HistogramMatrix *read_histograms_frames (const RunParameters &parameters, const string &filename);
+static bool read_pixel_count_difference (const RunParameters &parameters, const string &filename, vector<QVector<double> > *data);
+static void schedule_feature (const RunParameters &parameters, FrameFeature *feature, FeatureEngine *engine);
+
+/**
+ * Return the columns of the caches with a histogram per frame.
+ */
+static vector<ColumnTable::Column> histogram_columns ()
+{
+	return vector<ColumnTable::Column> (1, ColumnTable::Column {"histogram", NUMBER_COLOUR_LEVELS});
+}
+
+/**
+ * Write the values with the given index of the pixel count difference data to
+ * a row of a pixel count difference table.
+ */
+static void write_pixel_count_difference (ColumnTable &table, unsigned int index_row, const vector<QVector<double> > &data, unsigned int index_value)
+{
+	for (unsigned int index_column = 0; index_column < data.size (); index_column++)
+		*table.row (index_column, index_row) = data [index_column][index_value];
+}
+
+/**
+ * Return the columns of the caches with the most common colour of each frame.
+ */
+static vector<ColumnTable::Column> most_common_colour_columns ()
+{
+	return vector<ColumnTable::Column> (1, ColumnTable::Column {"most-common-colour", 1});
+}
+
+/**
+ * Append the given number of rows, from the first, of a pixel count difference
+ * table to the pixel count difference data.
+ */
+static void append_pixel_count_difference (const ColumnTable &table, unsigned int number_rows, vector<QVector<double> > *data)
+{
+	for (unsigned int index_column = 0; index_column < data->size (); index_column++) {
+		QVector<double> &column = (*data) [index_column];
+		column.reserve (table.number_rows ());
+		const int32_t *values = table.row (index_column, 0);
+		for (unsigned int index_row = 0; index_row < number_rows; index_row++)
+			column.append (values [index_row]);
+	}
+}
+
+/**
+ * Histogram of entire video frames.
+ */
+class HistogramFeature:
+	public CachedFrameFeature
+{
+	HistogramMatrix *result;
+	Histogram histogram;
+public:
+	HistogramFeature (const string &filename, const RunParameters &parameters, HistogramMatrix *result):
+		CachedFrameFeature (filename, parameters, histogram_columns ()),
+		result (result)
+	{
+		result->read (this->table, this->first - 1);
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		compute_histogram (frame, this->histogram);
+		this->result->set (index_frame, this->histogram);
+		this->result->write_frame (this->table, index_frame);
+	}
+};
+
+/**
+ * Histogram of a rectangular area of video frames.  The histogram is computed
+ * from the pixels of the area.  The tile histograms of the frame are written
+ * to the histogram index, so that other rectangles do not need to decode the
+ * video frames.
+ * The index is written as a stream: it is not resumed, but it is extended
+ * with the frames added to the folder.  Runs that process a shard of the
+ * frames do not write it.  Unless the frames are packed, the index only
+ * spares decoding the frames for rectangles aligned with the tiles.
+ */
+class HistogramRectFeature:
+	public CachedFrameFeature
+{
+	const int x1, y1, x2, y2;
+	HistogramMatrix *result;
+	Histogram histogram;
+	TileHistograms tiles;
+	CacheFile index_file;
+	/**
+	 * First frame whose tile histograms are not in the index.
+	 */
+	const unsigned int index_first;
+	const bool write_index;
+public:
+	HistogramRectFeature (const string &filename, const UserParameters &parameters, HistogramMatrix *result):
+		CachedFrameFeature (filename, parameters, histogram_columns ()),
+		x1 (parameters.x1), y1 (parameters.y1), x2 (parameters.x2), y2 (parameters.y2),
+		result (result),
+		tiles (HISTOGRAM_INDEX_TILE_SIZE, parameters.frame_size),
+		index_file (parameters.histogram_index_filename ()),
+		index_first (tiles.begin_index (parameters, parameters.histogram_index_filename (), index_file.get ()) + 1),
+		write_index (!parameters.sharded () && index_first <= parameters.number_frames)
+	{
+		// a complete index is kept and the rectangle table resumed
+		if (this->write_index)
+			this->first = min (this->first, this->index_first);
+		result->read (this->table, this->first - 1);
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		if (this->write_index && index_frame >= this->index_first) {
+			this->tiles.compute (frame);
+			this->tiles.write (this->index_file.get ());
+		}
+		compute_histogram (frame, this->x1, this->y1, this->x2, this->y2, this->histogram);
+		this->result->set (index_frame, this->histogram);
+		this->result->write_frame (this->table, index_frame);
+	}
+	virtual void finish ()
+	{
+		CachedFrameFeature::finish ();
+		if (this->write_index)
+			this->index_file.commit ();
+	}
+};
+
+/**
+ * Most common colour in a rectangular area of video frames.
+ *
+ * The rows of a shard table before the shard are empty, but the light
+ * calibrated pixel count difference needs the most common colour of the
+ * frames that fill its window of previous frames.  These frames are presented
+ * as history and their most common colour is only kept in the result.
+ */
+class HighestColourLevelRectFeature:
+	public CachedFrameFeature
+{
+	const int x1, y1, x2, y2;
+	QVector<double> *result;
+	Histogram histogram;
+	unsigned int number_history_frames;
+public:
+	HighestColourLevelRectFeature (const string &filename, const UserParameters &parameters, QVector<double> *result):
+		CachedFrameFeature (filename, parameters, most_common_colour_columns ()),
+		x1 (parameters.x1), y1 (parameters.y1), x2 (parameters.x2), y2 (parameters.y2),
+		result (result),
+		number_history_frames (0)
+	{
+		for (unsigned int index_row = 0; index_row < this->first - 1; index_row++)
+			result->append (*this->table.row (0, index_row));
+		// window of previous frames of the pixel count difference
+		unsigned int window = parameters.delta_frame + 1;
+		unsigned int history_first = this->first > window ? this->first - window : 1;
+		if (history_first < parameters.shard_first_frame ())
+			this->number_history_frames = this->first - history_first;
+	}
+	virtual unsigned int history () const
+	{
+		return this->number_history_frames;
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		compute_histogram (frame, this->x1, this->y1, this->x2, this->y2, this->histogram);
+		int value = this->histogram.most_common_colour ();
+		if (index_frame < this->first) {
+			(*this->result) [index_frame - 1] = value;
+			return ;
+		}
+		this->result->append (value);
+		*this->table.row (0, index_frame - 1) = value;
+	}
+};
+
+/**
+ * Histogram of video frames that were light calibrated with the most common
+ * colour of each frame.
+ */
+class HistogramLightCalibratedFeature:
+	public CachedFrameFeature
+{
+	const unsigned int pb;
+	void (*method) (const cv::Mat &, cv::Mat &, unsigned int, unsigned int);
+	HistogramMatrix *result;
+	Histogram histogram;
+	/**
+	 * Light calibrated frame, reused between frames.
+	 */
+	cv::Mat calibrated;
+public:
+	HistogramLightCalibratedFeature (const string &filename, const RunParameters &parameters, unsigned int pb, void (*method) (const cv::Mat &, cv::Mat &, unsigned int, unsigned int), HistogramMatrix *result):
+		CachedFrameFeature (filename, parameters, histogram_columns ()),
+		pb (pb),
+		method (method),
+		result (result)
+	{
+		result->read (this->table, this->first - 1);
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		compute_histogram (frame, this->histogram);
+		unsigned int pf = this->histogram.most_common_colour ();
+		this->method (frame, this->calibrated, this->pb, pf);
+		compute_histogram (this->calibrated, this->histogram);
+		this->result->set (index_frame, this->histogram);
+		this->result->write_frame (this->table, index_frame);
+	}
+};
+
+/**
+ * Pixel count difference between background image and pre-processed frame and
+ * between pre-processed frames afar.  The pre-processing function receives the
+ * experiment, the frame index and the raw frame, and returns the frame to use.
+ *
+ * The histograms of the differences are only written to a second cache file,
+ * which is read when the same colour threshold changes.  When resumed, the
+ * frames before the first one only fill the window of previous frames.
+ */
+template<typename P>
+class PixelCountDifferenceFeature:
+	public CachedFrameFeature
+{
+	const Experiment &experiment;
+	const cv::Mat background;
+	P pre_process;
+	FrameRing ring;
+	ImageScratch scratch;
+	vector<QVector<double> > *result;
+	DifferenceHistograms histograms;
+	CacheTable histograms_table;
+public:
+	PixelCountDifferenceFeature (const string &filename, const string &histograms_filename, const Experiment &experiment, const cv::Mat &background, P pre_process, vector<QVector<double> > *result):
+		CachedFrameFeature (filename, experiment.parameters, DifferenceHistograms::pixel_count_difference_columns (experiment.parameters.number_ROIs)),
+		experiment (experiment),
+		background (background),
+		pre_process (pre_process),
+		ring (experiment.parameters.delta_frame + 1),
+		result (result),
+		histograms (experiment.parameters.number_ROIs),
+		histograms_table (experiment.parameters, histograms_filename, histograms.histogram_columns ())
+	{
+		this->first = min (this->first, this->histograms_table.number_complete_rows () + 1);
+		append_pixel_count_difference (this->table, this->first - 1, result);
+	}
+	virtual unsigned int history () const
+	{
+		return this->ring.capacity ();
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		cv::Mat processed = this->pre_process (this->experiment, index_frame, frame);
+		if (index_frame < this->first) {
+			this->ring.push (processed);
+			return ;
+		}
+		// the histograms are only kept in their cache table
+		this->histograms.clear ();
+		compute_pixel_count_difference (this->scratch, this->experiment, this->background, processed, &this->ring, this->result, &this->histograms);
+		write_pixel_count_difference (this->table, index_frame - 1, *this->result, this->result->front ().size () - 1);
+		this->histograms.write_frame (this->histograms_table.get (), index_frame - 1, 1);
+	}
+	virtual void checkpoint (unsigned int index_frame)
+	{
+		CachedFrameFeature::checkpoint (index_frame);
+		this->histograms_table.checkpoint (index_frame);
+	}
+	virtual void finish ()
+	{
+		CachedFrameFeature::finish ();
+		this->histograms_table.commit ();
+	}
+};
+
+/**
+ * Pixel count difference on raw frames for several frame gaps.  A single ring
+ * of previous frames, sized to the largest gap, is shared by all gaps.  The
+ * cache files are the same as the ones of a run with each frame gap.  When
+ * resumed, all gaps start after the row that is complete in all cache files.
+ */
+class DeltaFramesFeature:
+	public FrameFeature
+{
+	const Experiment &experiment;
+	const vector<unsigned int> delta_frames;
+	FrameRing ring;
+	ImageScratch scratch;
+	vector<DifferenceHistograms *> difference_histograms;
+	vector<vector<QVector<double> > *> results;
+	vector<CacheTable *> tables;
+	vector<CacheTable *> histograms_tables;
+	unsigned int first;
+public:
+	DeltaFramesFeature (const Experiment &experiment, const vector<unsigned int> &delta_frames, map<unsigned int, vector<QVector<double> > *> *results):
+		experiment (experiment),
+		delta_frames (delta_frames),
+		ring (*max_element (delta_frames.begin (), delta_frames.end ()) + 1),
+		first (experiment.parameters.number_frames + 1)
+	{
+		for (unsigned int delta_frame : delta_frames) {
+			this->difference_histograms.push_back (new DifferenceHistograms (experiment.parameters.number_ROIs));
+			this->results.push_back (results->at (delta_frame));
+			this->tables.push_back (new CacheTable (experiment.parameters, experiment.parameters.features_pixel_count_difference_raw_filename (delta_frame), DifferenceHistograms::pixel_count_difference_columns (experiment.parameters.number_ROIs)));
+			this->histograms_tables.push_back (new CacheTable (experiment.parameters, experiment.parameters.difference_histograms_raw_filename (delta_frame), this->difference_histograms.back ()->histogram_columns ()));
+			this->first = min (this->first, min (this->tables.back ()->number_complete_rows (), this->histograms_tables.back ()->number_complete_rows ()) + 1);
+		}
+		for (unsigned int index = 0; index < this->tables.size (); index++)
+			append_pixel_count_difference (this->tables [index]->get (), this->first - 1, this->results [index]);
+	}
+	virtual ~DeltaFramesFeature ()
+	{
+		for (unsigned int index = 0; index < this->tables.size (); index++) {
+			delete this->tables [index];
+			delete this->histograms_tables [index];
+			delete this->difference_histograms [index];
+		}
+	}
+	virtual unsigned int first_frame () const
+	{
+		return this->first;
+	}
+	virtual unsigned int history () const
+	{
+		return this->ring.capacity ();
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		if (index_frame < this->first) {
+			this->ring.push (frame);
+			return ;
+		}
+		// the histograms are only kept in their cache tables
+		for (DifferenceHistograms *histograms : this->difference_histograms)
+			histograms->clear ();
+		compute_difference_histograms_delta_frames (this->scratch, this->experiment, this->experiment.background, frame, this->delta_frames, &this->ring, this->difference_histograms);
+		unsigned int same_colour_level = this->experiment.parameters.get_same_colour_level ();
+		for (unsigned int index = 0; index < this->delta_frames.size (); index++) {
+			const DifferenceHistograms *histograms = this->difference_histograms [index];
+			for (unsigned int index_ROI = 0; index_ROI < this->experiment.parameters.number_ROIs; index_ROI++) {
+				(*this->results [index]) [2 * index_ROI].append (histograms->number_different_pixels (1, index_ROI, DifferenceHistograms::BACKGROUND, same_colour_level));
+				(*this->results [index]) [2 * index_ROI + 1].append (histograms->number_different_pixels (1, index_ROI, DifferenceHistograms::PREVIOUS, same_colour_level));
+			}
+			histograms->write_pixel_count_difference (this->tables [index]->get (), index_frame - 1, 1, same_colour_level);
+			histograms->write_frame (this->histograms_tables [index]->get (), index_frame - 1, 1);
+		}
+	}
+	virtual void checkpoint (unsigned int index_frame)
+	{
+		for (unsigned int index = 0; index < this->tables.size (); index++) {
+			this->tables [index]->checkpoint (index_frame);
+			this->histograms_tables [index]->checkpoint (index_frame);
+		}
+	}
+	virtual void finish ()
+	{
+		for (unsigned int index = 0; index < this->tables.size (); index++) {
+			this->tables [index]->commit ();
+			this->histograms_tables [index]->commit ();
+		}
+	}
+};
 
 Histogram *compute_histogram_background (const RunParameters &parameters)
 {
 	fprintf (stderr, "Computing histogram of background image...\n");
 	Histogram *result = new Histogram ();
 	string filename = parameters.histogram_background_filename ();
-	if (access (filename.c_str (), R_OK) == 0) {
-		fprintf (stderr, "  reading data from file %s\n", filename.c_str ());
-		FILE *file = fopen (filename.c_str (), "r");
-		result->read (file);
+	FILE *file = fopen (filename.c_str (), "r");
+	bool ok = file != NULL && result->read (file);
+	if (file != NULL)
 		fclose (file);
-	}
+	if (ok)
+		fprintf (stderr, "  read data from file %s\n", filename.c_str ());
 	else {
 		fprintf (stderr, "  processing background image in folder %s\n", parameters.folder.c_str ());
 		compute_histogram (read_background (parameters), *result);
-		FILE *file = fopen (filename.c_str (), "w");
-		result->write (file);
-		fprintf (file, "\n");
-		fclose (file);
+		CacheFile cache (filename);
+		result->write (cache.get ());
+		fprintf (cache.get (), "\n");
+		cache.commit ();
 	}
 	return result;
 }
 
-map<int, Histogram> *compute_histogram_frames_all (const RunParameters &parameters)
+HistogramMatrix *compute_histogram_frames_all (const RunParameters &parameters, FeatureEngine *engine)
 {
 	fprintf (stderr, "Computing histogram of entire video frames...\n");
-	map<int, Histogram> *result;
+	HistogramMatrix *result;
 	string filename = parameters.histogram_frames_all_filename ();
-	if (access (filename.c_str (), F_OK) == 0) {
-		fprintf (stderr, "  reading data from file %s\n", filename.c_str ());
-		result = read_histograms_frames (parameters, filename);
-	}
-	else {
-		fprintf (stderr, "  processing video frames in folder %s\n", parameters.folder.c_str ());
-		FILE *file = fopen (filename.c_str (), "w");
-		result = new map<int, Histogram> ();
-		for (unsigned int index_frame = 1; index_frame <= parameters.number_frames; index_frame++) {
-			string filename = parameters.frame_filename (index_frame);
-			compute_histogram (read_frame (parameters, index_frame), (*result) [index_frame]);
-			(*result) [index_frame].write (file);
-			fprintf (file, "\n");
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
-		fclose (file);
+	if ((result = read_histograms_frames (parameters, filename)) == NULL) {
+		result = new HistogramMatrix (parameters.number_frames);
+		schedule_feature (parameters, new HistogramFeature (filename, parameters, result), engine);
 	}
 	return result;
 }
@@ -67,95 +411,52 @@ map<int, Histogram> *compute_histogram_frames_all (const RunParameters &paramete
 // }
 
 
-map<int, Histogram> *compute_histogram_frames_rect (const UserParameters &parameters)
+HistogramMatrix *compute_histogram_frames_rect (const UserParameters &parameters, FeatureEngine *engine)
 {
 	fprintf (stderr, "Computing histogram in rectangle %s of all video frames...\n", parameters.rectangle_user ().c_str ());
-	map<int, Histogram> *result;
 	string filename = parameters.histogram_frames_rect ();
-	if (access (filename.c_str (), F_OK) == 0) {
-		fprintf (stderr, "  reading data from file %s\n", filename.c_str ());
-		result = read_histograms_frames (parameters, filename.c_str ());
-	}
-	else {
-		fprintf (stderr, "  processing video frames in folder %s\n", parameters.folder.c_str ());
-		FILE *file = fopen (filename.c_str (), "w");
-		result = new map<int, Histogram> ();
-		for (unsigned int index_frame = 1; index_frame <= parameters.number_frames; index_frame++) {
-			Image frame = read_frame (parameters, index_frame);
-			compute_histogram (frame, parameters.x1, parameters.y1, parameters.x2, parameters.y2, (*result) [index_frame]);
-			(*result) [index_frame].write (file);
-			fprintf (file, "\n");
-			fprintf (stderr, "\r    %d", index_frame);
-			fflush (stderr);
-		}
-		fprintf (stderr, "\n");
-		fclose (file);
+	HistogramMatrix *result = read_histograms_frames (parameters, filename);
+	if (result == NULL)
+		result = read_histogram_index_rect (parameters, parameters.histogram_index_filename (), parameters.x1, parameters.y1, parameters.x2, parameters.y2);
+	if (result == NULL) {
+		result = new HistogramMatrix (parameters.number_frames);
+		schedule_feature (parameters, new HistogramRectFeature (filename, parameters, result), engine);
 	}
 	return result;
 }
 
-map<int, Histogram> *compute_histogram_frames_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment)
+HistogramMatrix *compute_histogram_frames_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment, FeatureEngine *engine)
 {
 	fprintf (stderr,
 	         "Computing histogram of frames that were light calibrated using the PLSM method."
 	         "  Light calibration uses the most common colour in rectangle %s for each frame.\n",
 	         experiment.parameters.rectangle_user ().c_str ());
-	map<int, Histogram> *result;
+	HistogramMatrix *result;
 	string filename = experiment.parameters.histogram_frames_light_calibrated_most_common_colour_method_PLSM_filename ();
-	if (access (filename.c_str (), F_OK) == 0) {
-		result = read_histograms_frames (experiment.parameters, filename);
-	}
-	else {
+	if ((result = read_histograms_frames (experiment.parameters, filename)) == NULL) {
 		Histogram histogram;
 		compute_histogram (experiment.background, histogram);
 		unsigned int pb = histogram.most_common_colour ();
-		result = new map<int, Histogram> ();
-		typedef void (*fold3_func) (unsigned int, const string &, unsigned int, FILE *, map<int, Histogram> *);
-		fold3_func func = [] (unsigned int index_frame, const string &filename, unsigned int pb, FILE *_file, map<int, Histogram> *_result) {
-			cv::Mat frame = read_image (filename);
-			compute_histogram (frame, (*_result) [index_frame]);
-			unsigned int pf = (*_result) [index_frame].most_common_colour ();
-			light_calibrate_method_PLSM (frame, pb, pf);
-			compute_histogram (frame, (*_result) [index_frame]);
-			(*_result) [index_frame].write (_file);
-			fprintf (_file, "\n");
-		};
-		FILE *file = fopen (filename.c_str (), "w");
-		experiment.parameters.fold3_frames_IF (func, pb, file, result);
-		fclose (file);
+		result = new HistogramMatrix (experiment.parameters.number_frames);
+		schedule_feature (experiment.parameters, new HistogramLightCalibratedFeature (filename, experiment.parameters, pb, light_calibrate_method_PLSM, result), engine);
 	}
 	return result;
 }
 
-map<int, Histogram> *compute_histogram_frames_light_calibrated_most_common_colour_method_LC (const Experiment &experiment)
+HistogramMatrix *compute_histogram_frames_light_calibrated_most_common_colour_method_LC (const Experiment &experiment, FeatureEngine *engine)
 {
 	fprintf (stderr,
 	         "Computing histogram of frames that were light calibrated using the LC method."
 	         "  Light calibration uses the most common colour in rectangle %s for each frame.\n",
 	         experiment.parameters.rectangle_user ().c_str ());
-	map<int, Histogram> *result;
+	HistogramMatrix *result;
 	string filename = experiment.parameters.histogram_frames_light_calibrated_most_common_colour_method_LC_filename ();
-	if (access (filename.c_str (), F_OK) == 0) {
-		result = read_histograms_frames (experiment.parameters, filename);
-	}
-	else {
+	if ((result = read_histograms_frames (experiment.parameters, filename)) == NULL) {
 		Histogram histogram;
 		compute_histogram (experiment.background, histogram);
 		unsigned int pb = histogram.most_common_colour ();
-		result = new map<int, Histogram> ();
-		typedef void (*fold3_func) (unsigned int, const string &, unsigned int, FILE *, map<int, Histogram> *);
-		fold3_func func = [] (unsigned int index_frame, const string &filename, unsigned int pb, FILE *_file, map<int, Histogram> *_result) {
-			cv::Mat frame = read_image (filename);
-			compute_histogram (frame, (*_result) [index_frame]);
-			unsigned int pf = (*_result) [index_frame].most_common_colour ();
-			light_calibrate_method_LC (frame, pb, pf);
-			compute_histogram (frame, (*_result) [index_frame]);
-			(*_result) [index_frame].write (_file);
-			fprintf (_file, "\n");
-		};
-		FILE *file = fopen (filename.c_str (), "w");
-		experiment.parameters.fold3_frames_IF (func, pb, file, result);
-		fclose (file);
+		result = new HistogramMatrix (experiment.parameters.number_frames);
+		schedule_feature (experiment.parameters, new HistogramLightCalibratedFeature (filename, experiment.parameters, pb, light_calibrate_method_LC, result), engine);
 	}
 	return result;
 }
@@ -169,12 +470,99 @@ void delete_histograms (map<int, QVector<double> *> *histograms)
 	delete histograms;
 }
 
+/**
+ * Compute the pixel count difference in chunks of frames that are processed in
+ * parallel.  Each chunk primes its window of previous frames with the frames
+ * that precede it, so the result is identical to a sequential pass.
+ */
+template<typename P>
+static void compute_pixel_count_difference_chunks (const Experiment &experiment, const string &filename, const string &histograms_filename, const cv::Mat &background, P pre_process, vector<QVector<double> > *result)
+{
+	const RunParameters &parameters = experiment.parameters;
+	const unsigned int chunk_size = parameters.pixel_count_difference_chunk_size;
+	const unsigned int last_frame = parameters.shard_last_frame ();
+	const unsigned int number_chunks = (last_frame + chunk_size - 1) / chunk_size;
+	struct Chunk {
+		vector<QVector<double> > data;
+	};
+	CacheTable table (parameters, filename, DifferenceHistograms::pixel_count_difference_columns (parameters.number_ROIs));
+	CacheTable histograms_table (parameters, histograms_filename, DifferenceHistograms (parameters.number_ROIs).histogram_columns ());
+	// an interrupted run is resumed from its last complete chunk, and a shard
+	// starts with the chunk that holds its first frame
+	const unsigned int first_frame = parameters.shard_first_frame ();
+	const unsigned int first_chunk = max (min (table.number_complete_rows (), histograms_table.number_complete_rows ()), first_frame - 1) / chunk_size;
+	append_pixel_count_difference (table.get (), max (first_chunk * chunk_size, first_frame - 1), result);
+	// chunks write their rows of the cache tables, which do not overlap
+	auto process_chunk = [&] (unsigned int index_chunk) {
+		Chunk chunk;
+		chunk.data.resize (2 * parameters.number_ROIs);
+		DifferenceHistograms histograms (parameters.number_ROIs);
+		unsigned int first = max (index_chunk * chunk_size + 1, first_frame);
+		unsigned int last = min (last_frame, (index_chunk + 1) * chunk_size);
+		if (first > last)
+			return chunk;
+		FrameRing ring (parameters.delta_frame + 1);
+		ImageScratch scratch;
+		unsigned int index_frame = first > parameters.delta_frame + 1 ? first - parameters.delta_frame - 1 : 1;
+		for (; index_frame < first; index_frame++)
+			ring.push (pre_process (experiment, index_frame, read_frame (parameters, index_frame)));
+		for (; index_frame <= last; index_frame++) {
+			cv::Mat frame = pre_process (experiment, index_frame, read_frame (parameters, index_frame));
+			histograms.clear ();
+			compute_pixel_count_difference (scratch, experiment, background, frame, &ring, &chunk.data, &histograms);
+			write_pixel_count_difference (table.get (), index_frame - 1, chunk.data, index_frame - first);
+			histograms.write_frame (histograms_table.get (), index_frame - 1, 1);
+		}
+		return chunk;
+	};
+	fprintf (stderr, "  processing video frames in folder %s in %d chunks of %d frames\n", parameters.folder.c_str (), number_chunks - first_chunk, chunk_size);
+	auto merge_chunk = [&] (unsigned int index_chunk, Chunk &chunk) {
+		for (unsigned int index_column = 0; index_column < chunk.data.size (); index_column++)
+			for (double value : chunk.data [index_column])
+				(*result) [index_column].append (value);
+		// chunks are merged in order, so all rows up to this chunk are done
+		unsigned int last = min (last_frame, (index_chunk + 1) * chunk_size);
+		if (last / parameters.checkpoint_interval > index_chunk * chunk_size / parameters.checkpoint_interval) {
+			table.checkpoint (last);
+			histograms_table.checkpoint (last);
+		}
+		fprintf (stderr, "\r    %d", last);
+		fflush (stderr);
+	};
+	parallel_ordered<Chunk> (parameters.number_threads, first_chunk, number_chunks - 1, process_chunk, merge_chunk);
+	fprintf (stderr, "\n");
+	table.commit ();
+	histograms_table.commit ();
+}
+
+/**
+ * Schedule the computation of the pixel count difference in the engine, either
+ * as a feature or, if chunks are used, as a job that runs after the features.
+ */
+template<typename P>
+static void schedule_pixel_count_difference (const Experiment &experiment, const string &filename, const string &histograms_filename, const cv::Mat &background, P pre_process, vector<QVector<double> > *result, FeatureEngine *engine)
+{
+	// chunks would make a sequential frame source seek back and forth
+	if (experiment.parameters.pixel_count_difference_chunk_size == 0 || experiment.parameters.frame_source ().sequential ()) {
+		schedule_feature (experiment.parameters, new PixelCountDifferenceFeature<P> (filename, histograms_filename, experiment, background, pre_process, result), engine);
+	}
+	else {
+		auto job = [&experiment, filename, histograms_filename, background, pre_process, result] () {
+			compute_pixel_count_difference_chunks (experiment, filename, histograms_filename, background, pre_process, result);
+		};
+		if (engine != NULL)
+			engine->defer (job);
+		else
+			job ();
+	}
+}
+
 // functions that operate on images
 
 cv::Mat compute_difference_background_image (const UserParameters &parameters, int index_frame)
 {
 	cv::Mat background = cv::imread (parameters.background_filename (), CV_LOAD_IMAGE_GRAYSCALE);
-	cv::Mat frame = cv::imread (parameters.frame_filename (index_frame), CV_LOAD_IMAGE_GRAYSCALE);
+	cv::Mat frame = read_frame (parameters, index_frame);
 	cv::Mat diff;
 	cv::absdiff (background, frame, diff);
 	return diff;
@@ -215,74 +603,46 @@ cv::Mat light_calibration (const Experiment &experiment, unsigned int index_fram
 	unsigned char pb = histogram.most_common_colour ();
 	unsigned char pf = (*experiment.highest_colour_level_frames_rect) [index_frame - 1];
 	fprintf (stderr, "Light calibration frame #%d with pb=%d and pf=%d\n", index_frame, pb, pf);
-	for(int i = 0; i < frame.rows; i++)
-		for(int j = 0; j < frame.cols; j++) {
-			unsigned char old_value = frame.at<unsigned char> (i, j);
-			if (old_value < pf)
-				frame.at<unsigned char> (i, j) = (old_value * pb) / pf;
-			else
-				frame.at<unsigned char> (i, j) = 255 - ((255 - old_value) * (255 - pb) / (255 - pf));
-		}
-	return frame;
+	cv::Mat result = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+	light_calibrate_method_PLSM (frame, result, pb, pf);
+	return result;
 }
 
-vector<QVector<double> > *compute_pixel_count_difference_raw (const Experiment &experiment)
+vector<QVector<double> > *compute_pixel_count_difference_raw (const Experiment &experiment, FeatureEngine *engine)
 {
 	fprintf (stderr, "Computing pixel count difference on raw frames. The difference is between background image and current frame and between %d frames afar.\n", experiment.parameters.delta_frame);
 	vector<QVector<double> > *result = new vector<QVector<double> > (2 * experiment.parameters.number_ROIs);
 	string data_filename = experiment.parameters.features_pixel_count_difference_raw_filename ();
-	if (access (data_filename.c_str (), F_OK) == 0) {
-		read_pixel_count_difference (experiment.parameters, data_filename, result);
-	}
-	else {
-		fprintf (stderr, "  processing video frames in folder %s\n", experiment.parameters.folder.c_str ());
-		queue<cv::Mat> cache;
-		typedef void (*fold4_func) (const string &, const Experiment *, FILE *, queue<cv::Mat> *, vector<QVector<double> > *);
-		fold4_func func = [] (const string &filename, const Experiment *_experiment,
-		      FILE *_file, queue<cv::Mat> *_cache, vector<QVector<double> > *_result) {
-			cv::Mat frame = read_image (filename);
-			compute_pixel_count_difference (*_experiment, _experiment->background, frame, _file, _cache, _result);
-			fprintf (_file, "\n");
+	string histograms_filename = experiment.parameters.difference_histograms_raw_filename ();
+	if (!read_pixel_count_difference (experiment.parameters, data_filename, result)) {
+		auto pre_process = [] (const Experiment &, unsigned int, const cv::Mat &frame) {
+			return frame;
 		};
-		FILE *file = fopen (data_filename.c_str (), "w");
-		experiment.parameters.fold4_frames_F (func, &experiment, file, &cache, result);
-		fclose (file);
+		schedule_pixel_count_difference (experiment, data_filename, histograms_filename, experiment.background, pre_process, result, engine);
 	}
 	return result;
 }
 
-vector<QVector<double> > *compute_pixel_count_difference_histogram_equalization (const Experiment &experiment)
+vector<QVector<double> > *compute_pixel_count_difference_histogram_equalization (const Experiment &experiment, FeatureEngine *engine)
 {
 	fprintf (stderr, "Computing pixel count difference on frames that have gone through histogram equalization between background images and current frame and between %d frames afar.\n", experiment.parameters.delta_frame);
 	vector<QVector<double> > *result = new vector<QVector<double> > (2 * experiment.parameters.number_ROIs);
 	string data_filename = experiment.parameters.features_pixel_count_difference_histogram_equalization_filename ();
-	if (access (data_filename.c_str (), F_OK) == 0) {
-		read_pixel_count_difference (experiment.parameters, data_filename, result);
-	}
-	else {
-		fprintf (stderr, "  processing video frames in folder %s\n", experiment.parameters.folder.c_str ());
-		queue<cv::Mat> cache;
-		typedef void (*fold5_func) (const string &, const Experiment *, FILE *, cv::Mat *, queue<cv::Mat> *, vector<QVector<double> > *);
-		fold5_func func = [] (
-		      const string &filename, const Experiment *_experiment, FILE *_file,
-		      cv::Mat *background_HE, queue<cv::Mat> *_cache,
-		      vector<QVector<double> > *_result) {
-			cv::Mat frame_raw = read_image (filename);
-			cv::Mat frame_HE;
-			equalizeHist (frame_raw, frame_HE);
-			compute_pixel_count_difference (*_experiment, *background_HE, frame_HE, _file, _cache, _result);
-			fprintf (_file, "\n");
+	string histograms_filename = experiment.parameters.difference_histograms_histogram_equalization_filename ();
+	if (!read_pixel_count_difference (experiment.parameters, data_filename, result)) {
+		auto pre_process = [] (const Experiment &, unsigned int, const cv::Mat &frame) {
+			cv::Mat frame_HE = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+			cv::equalizeHist (frame, frame_HE);
+			return frame_HE;
 		};
 		cv::Mat background_HE;
 		cv::equalizeHist (experiment.background, background_HE);
-		FILE *file = fopen (data_filename.c_str (), "w");
-		experiment.parameters.fold5_frames_F (func, &experiment, file, &background_HE, &cache, result);
-		fclose (file);
+		schedule_pixel_count_difference (experiment, data_filename, histograms_filename, background_HE, pre_process, result, engine);
 	}
 	return result;
 }
 
-vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment)
+vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment, FeatureEngine *engine)
 {
 	fprintf (stderr,
 	         "Computing pixel count difference on frames that have been light calibrated using the most common colour in rectangle %s."
@@ -291,29 +651,21 @@ vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_c
 	         experiment.parameters.rectangle_user ().c_str (), experiment.parameters.delta_frame);
 	vector<QVector<double> > *result = new vector<QVector<double> > (2 * experiment.parameters.number_ROIs);
 	string data_filename = experiment.parameters.features_pixel_count_difference_light_calibrated_most_common_colour_filename_method_PLSM ();
-	if (access (data_filename.c_str (), F_OK) == 0) {
-		read_pixel_count_difference (experiment.parameters, data_filename, result);
-	}
-	else {
-		fprintf (stderr, "  processing video frames in folder %s\n", experiment.parameters.folder.c_str ());
-		queue<cv::Mat> cache;
-		typedef void (*fold4_func) (unsigned int, const string &, const Experiment *, FILE *, queue<cv::Mat> *, vector<QVector<double> > *);
-		fold4_func func = [] (unsigned int index_frame, const string &filename, const Experiment *_experiment, FILE *_file, queue<cv::Mat> *_cache, vector<QVector<double> > *_result) {
-			cv::Mat frame = read_image (filename);
-			unsigned char pb = _experiment->histogram_background_raw->most_common_colour ();
-			unsigned char pf = (*_experiment->highest_colour_level_frames_rect) [index_frame - 1];
-			light_calibrate_method_PLSM (frame, pb, pf);
-			compute_pixel_count_difference (*_experiment, _experiment->background, frame, _file, _cache, _result);
-			fprintf (_file, "\n");
+	string histograms_filename = experiment.parameters.difference_histograms_light_calibrated_most_common_colour_filename_method_PLSM ();
+	if (!read_pixel_count_difference (experiment.parameters, data_filename, result)) {
+		auto pre_process = [] (const Experiment &_experiment, unsigned int index_frame, const cv::Mat &frame) {
+			cv::Mat result = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+			unsigned char pb = _experiment.histogram_background_raw->most_common_colour ();
+			unsigned char pf = (*_experiment.highest_colour_level_frames_rect) [index_frame - 1];
+			light_calibrate_method_PLSM (frame, result, pb, pf);
+			return result;
 		};
-		FILE *file = fopen (data_filename.c_str (), "w");
-		experiment.parameters.fold4_frames_IF (func, &experiment, file, &cache, result);
-		fclose (file);
+		schedule_pixel_count_difference (experiment, data_filename, histograms_filename, experiment.background, pre_process, result, engine);
 	}
 	return result;
 }
 
-vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (const Experiment &experiment)
+vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (const Experiment &experiment, FeatureEngine *engine)
 {
 	fprintf (stderr,
 	         "Computing pixel count difference on frames that have been light calibrated using the most common colour in rectangle %s."
@@ -322,105 +674,171 @@ vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_c
 	         experiment.parameters.rectangle_user ().c_str (), experiment.parameters.delta_frame);
 	vector<QVector<double> > *result = new vector<QVector<double> > (2 * experiment.parameters.number_ROIs);
 	string data_filename = experiment.parameters.features_pixel_count_difference_light_calibrated_most_common_colour_filename_method_LC ();
-	if (access (data_filename.c_str (), F_OK) == 0) {
-		read_pixel_count_difference (experiment.parameters, data_filename, result);
-	}
-	else {
-		fprintf (stderr, "  processing video frames in folder %s\n", experiment.parameters.folder.c_str ());
-		queue<cv::Mat> cache;
-		typedef void (*fold4_func) (unsigned int, const string &, const Experiment *, FILE *, queue<cv::Mat> *, vector<QVector<double> > *);
-		fold4_func func = [] (unsigned int index_frame, const string &filename, const Experiment *_experiment, FILE *_file, queue<cv::Mat> *_cache, vector<QVector<double> > *_result) {
-			cv::Mat frame = read_image (filename);
-			unsigned char pb = _experiment->histogram_background_raw->most_common_colour ();
-			unsigned char pf = (*_experiment->highest_colour_level_frames_rect) [index_frame - 1];
-			light_calibrate_method_LC (frame, pb, pf);
-			compute_pixel_count_difference (*_experiment, _experiment->background, frame, _file, _cache, _result);
-			fprintf (_file, "\n");
+	string histograms_filename = experiment.parameters.difference_histograms_light_calibrated_most_common_colour_filename_method_LC ();
+	if (!read_pixel_count_difference (experiment.parameters, data_filename, result)) {
+		auto pre_process = [] (const Experiment &_experiment, unsigned int index_frame, const cv::Mat &frame) {
+			cv::Mat result = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+			unsigned char pb = _experiment.histogram_background_raw->most_common_colour ();
+			unsigned char pf = (*_experiment.highest_colour_level_frames_rect) [index_frame - 1];
+			light_calibrate_method_LC (frame, result, pb, pf);
+			return result;
 		};
-		FILE *file = fopen (data_filename.c_str (), "w");
-		experiment.parameters.fold4_frames_IF (func, &experiment, file, &cache, result);
-		fclose (file);
+		schedule_pixel_count_difference (experiment, data_filename, histograms_filename, experiment.background, pre_process, result, engine);
 	}
 	return result;
 }
 
-QVector<double> *compute_highest_colour_level_frames_rect (const UserParameters &parameters)
+map<unsigned int, vector<QVector<double> > *> *compute_pixel_count_difference_raw_delta_frames (const Experiment &experiment, FeatureEngine *engine)
+{
+	const UserParameters &parameters = experiment.parameters;
+	map<unsigned int, vector<QVector<double> > *> *result = new map<unsigned int, vector<QVector<double> > *> ();
+	vector<unsigned int> missing_delta_frames;
+	for (unsigned int delta_frame : parameters.extra_delta_frames) {
+		fprintf (stderr, "Computing pixel count difference on raw frames between %d frames afar.\n", delta_frame);
+		(*result) [delta_frame] = new vector<QVector<double> > (2 * parameters.number_ROIs);
+		string data_filename = parameters.features_pixel_count_difference_raw_filename (delta_frame);
+		if (!read_pixel_count_difference (parameters, data_filename, (*result) [delta_frame]))
+			missing_delta_frames.push_back (delta_frame);
+	}
+	if (!missing_delta_frames.empty ())
+		schedule_feature (parameters, new DeltaFramesFeature (experiment, missing_delta_frames, result), engine);
+	return result;
+}
+
+QVector<double> *compute_highest_colour_level_frames_rect (const UserParameters &parameters, FeatureEngine *engine)
 {
 	fprintf (stderr, "Computing the most common colour in rectangle %s of raw frames...\n", parameters.rectangle_user ().c_str ());
 	QVector<double> *result = new QVector<double> ();
 	string filename = parameters.highest_colour_level_frames_rect_filename ();
-	if (access (filename.c_str (), F_OK) == 0) {
-		fprintf (stderr, "  reading data from file %s\n", filename.c_str ());
-		FILE *file = fopen (filename.c_str (), "r");
-		typedef void (*fold2_func) (QVector<double> *, FILE *);
-		fold2_func func = [] (QVector<double> *_result, FILE *_file) {
-			int value;
-			fscanf (_file, "%d", &value);
-			_result->append (value);
-		};
-		parameters.fold2_frames_V (func, result, file);
-		fclose (file);
+	string legacy_filename = legacy_csv_filename (filename);
+	ColumnTable *table = open_cache_table (parameters, filename, most_common_colour_columns ());
+	if (table != NULL) {
+		result->reserve (parameters.number_frames);
+		for (unsigned int index_row = 0; index_row < table->number_rows (); index_row++)
+			result->append (*table->row (0, index_row));
+		delete table;
 	}
-	else {
-		fprintf (stderr, "  computing from frames histograms\n");
-		FILE *file = fopen (filename.c_str (), "w");
-		map<int, Histogram> *map_histograms = compute_histogram_frames_rect (parameters);
-		typedef void (*fold3_func) (unsigned int, map<int, Histogram> *, QVector<double> *, FILE *);
-		fold3_func func3 = [] (unsigned int index_frame, map<int, Histogram> *_map_histograms, QVector<double> *_result, FILE *_file) {
-			const Histogram &an_histogram = _map_histograms->at (index_frame);
-			int value = 0;
-			double best = an_histogram [0];
-			for (unsigned int colour = 1; colour < NUMBER_COLOUR_LEVELS; colour++)
-				if (an_histogram [colour] > best) {
-					best = an_histogram [colour];
-					value = colour;
-				}
-			_result->append (value);
-			fprintf (_file, "%d\n", value);
-		};
-		parameters.fold3_frames_I (func3, map_histograms, result, file);
-		delete map_histograms;
+	else if (access (legacy_filename.c_str (), F_OK) == 0) {
+		fprintf (stderr, "  reading data from file %s\n", legacy_filename.c_str ());
+		FILE *file = fopen (legacy_filename.c_str (), "r");
+		int value;
+		while (result->size () < (int) parameters.number_frames && fscanf (file, "%d", &value) == 1)
+			result->append (value);
 		fclose (file);
 	}
+	if (result->size () < (int) parameters.number_frames) {
+		if (!result->isEmpty ()) {
+			fprintf (stderr, "  file %s does not have data for all frames, ignoring it\n", legacy_filename.c_str ());
+			result->clear ();
+		}
+		HistogramMatrix *histograms = read_histograms_frames (parameters, parameters.histogram_frames_rect ());
+		if (histograms == NULL)
+			histograms = read_histogram_index_rect (parameters, parameters.histogram_index_filename (), parameters.x1, parameters.y1, parameters.x2, parameters.y2);
+		if (histograms != NULL) {
+			fprintf (stderr, "  computing from frames histograms\n");
+			CacheTable table (parameters, filename, most_common_colour_columns ());
+			parameters.fold_frames ([&] (unsigned int index_frame) {
+				int value = histograms->most_common_colour (index_frame);
+				result->append (value);
+				*table.get ().row (0, index_frame - 1) = value;
+			});
+			delete histograms;
+			table.commit ();
+		}
+		else
+			schedule_feature (parameters, new HighestColourLevelRectFeature (filename, parameters, result), engine);
+	}
 	return result;
 }
 
 // private functions
 
-map<int, Histogram> *read_histograms_frames (const RunParameters &parameters, const string &filename)
+void schedule_feature (const RunParameters &parameters, FrameFeature *feature, FeatureEngine *engine)
 {
-	map<int, Histogram> *result = new map<int, Histogram> ();
-	FILE *file = fopen (filename.c_str (), "r");
-	for (unsigned int index_frame = 1; index_frame <= parameters.number_frames; index_frame++) {
-		(*result) [index_frame].read (file);
-	};
-	fclose (file);
+	if (engine != NULL) {
+		fprintf (stderr, "  scheduled for the next pass over video frames\n");
+		engine->add (feature);
+	}
+	else {
+		FeatureEngine local_engine (parameters);
+		local_engine.add (feature);
+		local_engine.run ();
+	}
+}
+
+/**
+ * Read the histograms of every frame from a cache table or, if there is none,
+ * from the comma separated values file used before.
+ *
+ * @return NULL if there is no cache.
+ */
+HistogramMatrix *read_histograms_frames (const RunParameters &parameters, const string &filename)
+{
+	HistogramMatrix *result;
+	ColumnTable *table = open_cache_table (parameters, filename, histogram_columns ());
+	string legacy_filename = legacy_csv_filename (filename);
+	if (table != NULL) {
+		result = new HistogramMatrix (parameters.number_frames);
+		result->read (*table, table->number_rows ());
+		delete table;
+	}
+	else if (access (legacy_filename.c_str (), F_OK) == 0) {
+		fprintf (stderr, "  reading data from file %s\n", legacy_filename.c_str ());
+		result = new HistogramMatrix (parameters.number_frames);
+		FILE *file = fopen (legacy_filename.c_str (), "r");
+		Histogram histogram;
+		bool ok = true;
+		for (unsigned int index_frame = 1; ok && index_frame <= parameters.number_frames; index_frame++)
+			if ((ok = histogram.read (file)))
+				result->set (index_frame, histogram);
+		fclose (file);
+		if (!ok) {
+			fprintf (stderr, "  file %s does not have data for all frames, ignoring it\n", legacy_filename.c_str ());
+			delete result;
+			result = NULL;
+		}
+	}
+	else
+		result = NULL;
 	return result;
 }
 
-void read_pixel_count_difference (const RunParameters &parameters, const string &filename, vector<QVector<double> > *data)
+/**
+ * Read the pixel count difference data from a cache table or, if there is
+ * none, from the comma separated values file used before.
+ *
+ * @return false if there is no cache.
+ */
+bool read_pixel_count_difference (const RunParameters &parameters, const string &filename, vector<QVector<double> > *data)
 {
-	fprintf (stderr, "  reading data from file %s\n", filename.c_str ());
-	typedef void (*fold_func) (unsigned int, vector<QVector<double> > *, FILE *, unsigned int );
-	fold_func func = [] (unsigned int index_frame, vector<QVector<double> > *_result, FILE *_file, unsigned int number_ROIs) {
-		for (unsigned int index_mask = 0; index_mask < number_ROIs; index_mask++) {
-			int value;
-			int ret;
-			ret = fscanf (_file, (index_mask > 0 ? ",%d" : "%d"), &value);
-			if (ret == 0) {
-				fprintf (stderr, "Error reading the %d-th pixel count value of the %d-th frame!\n", 2 * index_mask + 1, index_frame);
-				exit (1);
-			}
-			(*_result) [index_mask * 2].append (value);
-			ret = fscanf (_file, ",%d", &value);
-			if (ret == 0) {
-				fprintf (stderr, "Error reading the %d-th pixel count value of the %d-th frame!\n", 2 * (index_mask + 1), index_frame);
-				exit (1);
+	ColumnTable *table = open_cache_table (parameters, filename, DifferenceHistograms::pixel_count_difference_columns (parameters.number_ROIs));
+	if (table != NULL) {
+		append_pixel_count_difference (*table, table->number_rows (), data);
+		delete table;
+		return true;
+	}
+	string legacy_filename = legacy_csv_filename (filename);
+	if (access (legacy_filename.c_str (), F_OK) != 0)
+		return false;
+	fprintf (stderr, "  reading data from file %s\n", legacy_filename.c_str ());
+	FILE *file = fopen (legacy_filename.c_str (), "r");
+	bool ok = true;
+	for (unsigned int index_frame = 1; ok && index_frame <= parameters.number_frames; index_frame++) {
+		for (unsigned int index_mask = 0; ok && index_mask < parameters.number_ROIs; index_mask++) {
+			int background, previous;
+			ok = fscanf (file, (index_mask > 0 ? ",%d" : "%d"), &background) == 1
+			      && fscanf (file, ",%d", &previous) == 1;
+			if (ok) {
+				(*data) [index_mask * 2].append (background);
+				(*data) [index_mask * 2 + 1].append (previous);
 			}
-			(*_result) [index_mask * 2 + 1].append (value);
+			else
+				fprintf (stderr, "  file %s does not have data for frame %d, ignoring it\n", legacy_filename.c_str (), index_frame);
 		}
-	};
-	FILE *file = fopen (filename.c_str (), "r");
-	parameters.fold3_frames_I (func, data, file, parameters.number_ROIs);
+	}
 	fclose (file);
+	if (!ok)
+		for (QVector<double> &column : *data)
+			column.clear ();
+	return ok;
 }
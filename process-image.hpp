@@ -10,8 +10,24 @@
 #include "experiment.hpp"
 #include "image.hpp"
 #include "histogram.hpp"
+#include "histogram-matrix.hpp"
 
 class Experiment;
+class FeatureEngine;
+class DifferenceHistograms;
+
+/*
+ * The compute functions that process video frames read their data from a
+ * cache file if it exists.  Otherwise, if an engine is given, the computation
+ * is scheduled in the engine and the returned data is only filled when the
+ * engine runs.  This allows computing several features in a single pass over
+ * the video frames.  Without an engine, the video frames are processed
+ * immediately.
+ *
+ * The pixel count difference functions also write the histograms of the
+ * differences to a cache file.  When the video frames are processed, these
+ * histograms are appended to the given difference histograms, if any.
+ */
 
 /**
  * Compute the histogram for the backround image located in the given folder.
@@ -24,11 +40,11 @@ Histogram *compute_histogram_background (const RunParameters &parameters);
 /**
  * Compute the histogram for all the video frames located in the given folder.
  */
-std::map<int, Histogram> *compute_histogram_frames_all (const RunParameters &parameters);
+HistogramMatrix *compute_histogram_frames_all (const RunParameters &parameters, FeatureEngine *engine = NULL);
 
-std::map<int, Histogram> *compute_histogram_frames_ROI (const RunParameters &parameters, int indexROI);
+HistogramMatrix *compute_histogram_frames_ROI (const RunParameters &parameters, int indexROI);
 
-std::map<int, Histogram> *compute_histogram_frames_rect (const UserParameters &parameters);
+HistogramMatrix *compute_histogram_frames_rect (const UserParameters &parameters, FeatureEngine *engine = NULL);
 
 /**
  * @brief
@@ -40,9 +56,9 @@ std::map<int, Histogram> *compute_histogram_frames_rect (const UserParameters &p
  * @param experiment
  * @return
  */
-std::map<int, Histogram> *compute_histogram_frames_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment);
+HistogramMatrix *compute_histogram_frames_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment, FeatureEngine *engine = NULL);
 
-std::map<int, Histogram> *compute_histogram_frames_light_calibrated_most_common_colour_method_LC (const Experiment &experiment);
+HistogramMatrix *compute_histogram_frames_light_calibrated_most_common_colour_method_LC (const Experiment &experiment, FeatureEngine *engine = NULL);
 
 /**
  * Compute an image that corresponds to the absolute difference between the
@@ -77,9 +93,9 @@ cv::Mat compute_threshold_mask_diff_background_diff_previous (const UserParamete
  */
 cv::Mat light_calibration (const Experiment &experiment, unsigned int index_frame);
 
-std::vector<QVector<double> > *compute_pixel_count_difference_raw (const Experiment &experiment);
+std::vector<QVector<double> > *compute_pixel_count_difference_raw (const Experiment &experiment, FeatureEngine *engine = NULL);
 
-std::vector<QVector<double> > *compute_pixel_count_difference_histogram_equalization (const Experiment &experiment);
+std::vector<QVector<double> > *compute_pixel_count_difference_histogram_equalization (const Experiment &experiment, FeatureEngine *engine = NULL);
 
 /**
  * Compute the pixel count difference between background image and frame, and
@@ -89,15 +105,22 @@ std::vector<QVector<double> > *compute_pixel_count_difference_histogram_equaliza
  * This function assumes that the most common intensity in a rectangular area
  * has already been calculated.
  */
-std::vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment);
+std::vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (const Experiment &experiment, FeatureEngine *engine = NULL);
+
 
+std::vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (const Experiment &experiment, FeatureEngine *engine = NULL);
 
-std::vector<QVector<double> > *compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (const Experiment &experiment);
+/**
+ * Compute the pixel count difference on raw frames for each frame gap in the
+ * extra delta frames parameter, in a single pass over the video frames.  The
+ * result maps each frame gap to its data.
+ */
+std::map<unsigned int, std::vector<QVector<double> > *> *compute_pixel_count_difference_raw_delta_frames (const Experiment &experiment, FeatureEngine *engine);
 
 /**
  * For each frame compute the colour level with the highest count in the
  * histogram of a rectangular area (in the video frame).
  */
-QVector<double> *compute_highest_colour_level_frames_rect (const UserParameters &parameters);
+QVector<double> *compute_highest_colour_level_frames_rect (const UserParameters &parameters, FeatureEngine *engine = NULL);
 
 #endif
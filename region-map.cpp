@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "region-map.hpp"
+
+using namespace std;
+
+RegionMap::RegionMap (const vector<cv::Mat> &masks):
+	region_spans (masks.size ()),
+	pixels_outside (masks.size ())
+{
+	for (unsigned int index_region = 0; index_region < masks.size (); index_region++) {
+		const cv::Mat &mask = masks [index_region];
+		if (mask.empty () || mask.type () != CV_8UC1) {
+			fprintf (stderr, "Mask of region of interest %d is missing or is not a grey scale image!\n", index_region);
+			exit (EXIT_FAILURE);
+		}
+		vector<Span> &spans = this->region_spans [index_region];
+		unsigned int pixels_inside = 0;
+		for (int y = 0; y < mask.rows; y++) {
+			const unsigned char *row = mask.ptr<unsigned char> (y);
+			int x = 0;
+			while (x < mask.cols) {
+				if (row [x] == 0) {
+					x++;
+					continue;
+				}
+				Span span;
+				span.y = y;
+				span.x1 = x;
+				span.mask_value = row [x];
+				while (x < mask.cols && row [x] == span.mask_value)
+					x++;
+				span.x2 = x;
+				spans.push_back (span);
+				pixels_inside += span.x2 - span.x1;
+			}
+		}
+		this->pixels_outside [index_region] = mask.rows * mask.cols - pixels_inside;
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef __REGION_MAP__
+#define __REGION_MAP__
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief The RegionMap class is the compiled form of the masks of the regions
+ * of interest.  Each region is a list of horizontal spans of pixels with the
+ * same non zero mask value.  Per region statistics only visit the pixels in
+ * the spans.
+ *
+ * Masks can overlap and can have values other than 0 and 255, so each region
+ * keeps its own spans and the mask value of each span.
+ */
+class RegionMap
+{
+public:
+	struct Span {
+		int y;
+		/**
+		 * The span has columns x1 to x2-1.
+		 */
+		int x1;
+		int x2;
+		unsigned char mask_value;
+	};
+	RegionMap (const std::vector<cv::Mat> &masks);
+	unsigned int number_regions () const
+	{
+		return this->region_spans.size ();
+	}
+	const std::vector<Span> &spans (unsigned int index_region) const
+	{
+		return this->region_spans [index_region];
+	}
+	/**
+	 * @brief number_pixels_outside Return the number of pixels where the mask
+	 * of the given region is zero.
+	 */
+	unsigned int number_pixels_outside (unsigned int index_region) const
+	{
+		return this->pixels_outside [index_region];
+	}
+private:
+	std::vector<std::vector<Span> > region_spans;
+	std::vector<unsigned int> pixels_outside;
+};
+
+#endif
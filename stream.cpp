@@ -0,0 +1,354 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "stream.hpp"
+#include "difference-histograms.hpp"
+#include "experiment.hpp"
+#include "image.hpp"
+
+using namespace std;
+
+/**
+ * Milliseconds that a folder watch waits for events before checking whether
+ * the stream was interrupted.
+ */
+#define STREAM_POLL_TIMEOUT 500
+
+/**
+ * Set by the handler of the signals that stop a stream.
+ */
+static volatile sig_atomic_t stream_interrupted = 0;
+
+static void interrupt_stream (int)
+{
+	stream_interrupted = 1;
+}
+
+static double now ()
+{
+	return chrono::duration<double> (chrono::system_clock::now ().time_since_epoch ()).count ();
+}
+
+static bool all_digits (const string &text)
+{
+	return !text.empty () && text.find_first_not_of ("0123456789") == string::npos;
+}
+
+LiveFrameSource *LiveFrameSource::create (const string &source, const string &folder, const FrameNaming &naming)
+{
+	if (source.empty ())
+		return new FolderWatchFrameSource (folder, naming);
+	else
+		return new CaptureFrameSource (source);
+}
+
+FolderWatchFrameSource::FolderWatchFrameSource (const string &folder, const FrameNaming &naming):
+	folder (folder),
+	naming (naming),
+	next_index_frame (1),
+	last_existing_frame (0),
+	next_incomplete (false)
+{
+	this->descriptor = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+	if (this->descriptor == -1 || inotify_add_watch (this->descriptor, folder.c_str (), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		fprintf (stderr, "Could not watch folder %s: %s!\n", folder.c_str (), strerror (errno));
+		exit (EXIT_FAILURE);
+	}
+	// frames written before the watch started do not have events
+	struct stat status;
+	while (stat (naming.filename (folder, this->last_existing_frame + 1).c_str (), &status) == 0)
+		this->last_existing_frame++;
+	fprintf (stderr, "Watching folder %s, %u frames already in it\n", folder.c_str (), this->last_existing_frame);
+}
+
+FolderWatchFrameSource::~FolderWatchFrameSource ()
+{
+	close (this->descriptor);
+}
+
+void FolderWatchFrameSource::read_events ()
+{
+	char buffer [4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	ssize_t count;
+	while ((count = ::read (this->descriptor, buffer, sizeof (buffer))) > 0) {
+		for (char *event = buffer; event < buffer + count; event += sizeof (struct inotify_event) + ((struct inotify_event *) event)->len) {
+			const struct inotify_event *data = (const struct inotify_event *) event;
+			unsigned int index_frame;
+			if (data->len > 0 && this->naming.parse (data->name, index_frame) && index_frame >= this->next_index_frame)
+				this->ready.insert (index_frame);
+		}
+	}
+	if (count == -1 && errno != EAGAIN && errno != EINTR) {
+		fprintf (stderr, "Could not read the events of folder %s: %s!\n", this->folder.c_str (), strerror (errno));
+		exit (EXIT_FAILURE);
+	}
+}
+
+bool FolderWatchFrameSource::next (cv::Mat &frame, double &time_produced)
+{
+	string filename = this->naming.filename (this->folder, this->next_index_frame);
+	struct stat status;
+	for (;;) {
+		while ((this->next_index_frame > this->last_existing_frame || this->next_incomplete) && this->ready.count (this->next_index_frame) == 0) {
+			if (stream_interrupted)
+				return false;
+			struct pollfd request = {this->descriptor, POLLIN, 0};
+			if (poll (&request, 1, STREAM_POLL_TIMEOUT) > 0)
+				this->read_events ();
+		}
+		this->ready.erase (this->next_index_frame);
+		frame = cv::imread (filename, CV_LOAD_IMAGE_GRAYSCALE);
+		if (!frame.empty () && stat (filename.c_str (), &status) == 0)
+			break;
+		if (!this->next_incomplete)
+			fprintf (stderr, "Could not read image %s, waiting for it to be written\n", filename.c_str ());
+		this->next_incomplete = true;
+	}
+	time_produced = status.st_mtim.tv_sec + status.st_mtim.tv_nsec / 1e9;
+	this->next_incomplete = false;
+	this->next_index_frame++;
+	return true;
+}
+
+CaptureFrameSource::CaptureFrameSource (const string &name):
+	name (name)
+{
+	if (all_digits (name))
+		this->capture.open (atoi (name.c_str ()));
+	else
+		this->capture.open (name);
+	if (!this->capture.isOpened ()) {
+		fprintf (stderr, "Could not open video stream %s!\n", name.c_str ());
+		exit (EXIT_FAILURE);
+	}
+}
+
+bool CaptureFrameSource::next (cv::Mat &frame, double &time_produced)
+{
+	if (stream_interrupted || !this->capture.grab ())
+		return false;
+	time_produced = now ();
+	if (!this->capture.retrieve (this->buffer)) {
+		fprintf (stderr, "Could not decode a frame of video stream %s!\n", this->name.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	if (this->buffer.channels () == 1)
+		frame = this->buffer.clone ();
+	else
+		cv::cvtColor (this->buffer, frame, CV_BGR2GRAY);
+	return true;
+}
+
+StreamOutput::StreamOutput (const string &name):
+	file (NULL),
+	server (-1)
+{
+	if (name.compare (0, 5, "unix:") == 0) {
+		this->socket_path = name.substr (5);
+		struct sockaddr_un address;
+		memset (&address, 0, sizeof (address));
+		address.sun_family = AF_UNIX;
+		if (this->socket_path.size () >= sizeof (address.sun_path)) {
+			fprintf (stderr, "Socket path %s is too long!\n", this->socket_path.c_str ());
+			exit (EXIT_FAILURE);
+		}
+		strcpy (address.sun_path, this->socket_path.c_str ());
+		unlink (this->socket_path.c_str ());
+		this->server = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (this->server == -1
+		    || bind (this->server, (struct sockaddr *) &address, sizeof (address)) != 0
+		    || listen (this->server, 8) != 0) {
+			fprintf (stderr, "Could not create socket %s: %s!\n", this->socket_path.c_str (), strerror (errno));
+			exit (EXIT_FAILURE);
+		}
+		fprintf (stderr, "Writing the stream to the clients of socket %s\n", this->socket_path.c_str ());
+	}
+	else if (name == "-")
+		this->file = stdout;
+	else {
+		this->file = fopen (name.c_str (), "w");
+		if (this->file == NULL) {
+			fprintf (stderr, "Could not create file %s!\n", name.c_str ());
+			exit (EXIT_FAILURE);
+		}
+	}
+}
+
+StreamOutput::~StreamOutput ()
+{
+	if (this->file != NULL && this->file != stdout)
+		fclose (this->file);
+	for (const Client &client : this->clients)
+		close (client.descriptor);
+	if (this->server != -1) {
+		close (this->server);
+		unlink (this->socket_path.c_str ());
+	}
+}
+
+void StreamOutput::set_header (const string &line)
+{
+	this->header = line;
+	if (this->file != NULL && !line.empty ())
+		this->write (line);
+}
+
+void StreamOutput::accept_clients ()
+{
+	int descriptor;
+	while ((descriptor = accept4 (this->server, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+		Client client = {descriptor, this->header};
+		if (send_pending (client))
+			this->clients.push_back (client);
+		else
+			close (descriptor);
+	}
+}
+
+/**
+ * Send as much of the pending bytes of a client as it takes without waiting.
+ *
+ * @return false if the client is gone.
+ */
+bool StreamOutput::send_pending (Client &client)
+{
+	while (!client.pending.empty ()) {
+		ssize_t count = send (client.descriptor, client.pending.data (), client.pending.size (), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (count > 0)
+			client.pending.erase (0, count);
+		else if (count == -1 && errno == EINTR)
+			continue;
+		else
+			return count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+	return true;
+}
+
+void StreamOutput::write (const string &line)
+{
+	if (this->file != NULL) {
+		fputs (line.c_str (), this->file);
+		// each line is flushed so that it is read as soon as it is computed
+		if (fflush (this->file) != 0) {
+			fprintf (stderr, "Could not write the stream: %s!\n", strerror (errno));
+			stream_interrupted = 1;
+		}
+		return ;
+	}
+	this->accept_clients ();
+	for (unsigned int index = 0; index < this->clients.size (); ) {
+		Client &client = this->clients [index];
+		// a client that has not taken all of the previous line drops this one
+		bool ok = send_pending (client);
+		if (ok && client.pending.empty ()) {
+			client.pending = line;
+			ok = send_pending (client);
+		}
+		if (!ok) {
+			close (client.descriptor);
+			this->clients.erase (this->clients.begin () + index);
+		}
+		else
+			index++;
+	}
+}
+
+StreamStatistics::StreamStatistics ():
+	number_frames (0),
+	sum_latency (0),
+	maximum_latency (0)
+{
+}
+
+void StreamStatistics::add (double latency)
+{
+	this->number_frames++;
+	this->sum_latency += latency;
+	this->maximum_latency = max (this->maximum_latency, latency);
+}
+
+void StreamStatistics::print (FILE *file) const
+{
+	if (this->number_frames == 0)
+		fprintf (file, "  no frames analysed\n");
+	else
+		fprintf (file, "  %u frames analysed, latency %.1f ms on average and %.1f ms at most\n",
+		         this->number_frames, 1000 * this->sum_latency / this->number_frames, 1000 * this->maximum_latency);
+}
+
+void run_stream (const Experiment &experiment, LiveFrameSource *source, StreamOutput *output, bool csv)
+{
+	const RunParameters &parameters = experiment.parameters;
+	const unsigned int number_ROIs = parameters.number_ROIs;
+	const unsigned int same_colour_level = experiment.parameters.get_same_colour_level ();
+	const vector<unsigned int> delta_frames (1, parameters.delta_frame);
+	ImageScratch scratch;
+	FrameRing ring (parameters.delta_frame + 1);
+	DifferenceHistograms histograms (number_ROIs);
+	const vector<DifferenceHistograms *> histograms_pointers (1, &histograms);
+	StreamStatistics statistics;
+	struct sigaction action;
+	memset (&action, 0, sizeof (action));
+	action.sa_handler = interrupt_stream;
+	sigaction (SIGINT, &action, NULL);
+	sigaction (SIGTERM, &action, NULL);
+	signal (SIGPIPE, SIG_IGN);
+	if (csv) {
+		string header = "frame,time,latency";
+		for (unsigned int index_ROI = 1; index_ROI <= number_ROIs; index_ROI++)
+			header += ",difference-background-" + to_string (index_ROI) + ",difference-previous-" + to_string (index_ROI);
+		output->set_header (header + "\n");
+	}
+	fprintf (stderr, "Streaming the pixel count difference of %u regions of interest, press control-C to stop\n", number_ROIs);
+	cv::Mat frame;
+	double time_produced;
+	char number [64];
+	for (unsigned int index_frame = 1; !stream_interrupted && source->next (frame, time_produced); index_frame++) {
+		if (frame.size () != experiment.background.size ()) {
+			fprintf (stderr, "Frame %u has size %dx%d but the background image has size %dx%d!\n",
+			         index_frame, frame.cols, frame.rows, experiment.background.cols, experiment.background.rows);
+			exit (EXIT_FAILURE);
+		}
+		// only the histograms of the current frame are kept
+		histograms.clear ();
+		compute_difference_histograms_delta_frames (scratch, experiment, experiment.background, frame, delta_frames, &ring, histograms_pointers);
+		double latency = now () - time_produced;
+		statistics.add (latency);
+		string line = csv ? to_string (index_frame) : "{\"frame\":" + to_string (index_frame);
+		snprintf (number, sizeof (number), csv ? ",%.6f,%.6f" : ",\"time\":%.6f,\"latency\":%.6f", time_produced, latency);
+		line += number;
+		if (csv) {
+			// the two differences of each region of interest are together
+			for (unsigned int index_ROI = 0; index_ROI < number_ROIs; index_ROI++)
+				line +=
+				      "," + to_string (histograms.number_different_pixels (1, index_ROI, DifferenceHistograms::BACKGROUND, same_colour_level)) +
+				      "," + to_string (histograms.number_different_pixels (1, index_ROI, DifferenceHistograms::PREVIOUS, same_colour_level));
+		}
+		else {
+			for (DifferenceHistograms::Kind kind : {DifferenceHistograms::BACKGROUND, DifferenceHistograms::PREVIOUS}) {
+				line += kind == DifferenceHistograms::BACKGROUND ? ",\"difference-background\":[" : ",\"difference-previous\":[";
+				for (unsigned int index_ROI = 0; index_ROI < number_ROIs; index_ROI++)
+					line += (index_ROI == 0 ? "" : ",") + to_string (histograms.number_different_pixels (1, index_ROI, kind, same_colour_level));
+				line += "]";
+			}
+			line += "}";
+		}
+		output->write (line + "\n");
+		if (index_frame % parameters.checkpoint_interval == 0)
+			statistics.print (stderr);
+	}
+	fprintf (stderr, "Stream ended\n");
+	statistics.print (stderr);
+}
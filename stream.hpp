@@ -0,0 +1,155 @@
+#ifndef __STREAM__
+#define __STREAM__
+
+#include <set>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "frame-manifest.hpp"
+
+class Experiment;
+
+/**
+ * @brief The LiveFrameSource class provides the grey scale video frames of an
+ * experiment that is running, in order, as they are produced.
+ */
+class LiveFrameSource
+{
+public:
+	virtual ~LiveFrameSource () {}
+	/**
+	 * @brief next Wait for the next frame.  The time, in seconds since the
+	 * epoch, when the frame was produced is used to compute the latency of the
+	 * analysis.
+	 * @return false if the stream ended or was interrupted.
+	 */
+	virtual bool next (cv::Mat &frame, double &time_produced) = 0;
+	/**
+	 * Create the source of the frames written to the given folder if the
+	 * source name is empty.  Otherwise create the source of a video file,
+	 * stream URL or, if the name is a number, camera read through OpenCV.
+	 */
+	static LiveFrameSource *create (const std::string &source, const std::string &folder, const FrameNaming &naming);
+};
+
+/**
+ * @brief The FolderWatchFrameSource class reads the frames that are written to
+ * a folder, starting with the frames already in it.  The folder is watched
+ * with inotify and a frame is read once its file is closed or moved into the
+ * folder, so frames written out of order wait for the previous ones.  A frame
+ * that cannot be read, such as one that was still being written when the
+ * watch started, is read again when its file is next closed.
+ */
+class FolderWatchFrameSource:
+	public LiveFrameSource
+{
+	const std::string folder;
+	const FrameNaming naming;
+	int descriptor;
+	/**
+	 * Index of the frame returned by the next call to method next.
+	 */
+	unsigned int next_index_frame;
+	/**
+	 * Frames up to this one were in the folder when the watch started.
+	 */
+	unsigned int last_existing_frame;
+	/**
+	 * Frames after the next one whose files are complete.
+	 */
+	std::set<unsigned int> ready;
+	/**
+	 * The next frame could not be read and waits for its file to be closed.
+	 */
+	bool next_incomplete;
+	void read_events ();
+public:
+	FolderWatchFrameSource (const std::string &folder, const FrameNaming &naming);
+	virtual ~FolderWatchFrameSource ();
+	virtual bool next (cv::Mat &frame, double &time_produced);
+};
+
+/**
+ * @brief The CaptureFrameSource class decodes the frames of a video file,
+ * stream or camera.  The frame is produced when it is grabbed.
+ */
+class CaptureFrameSource:
+	public LiveFrameSource
+{
+	const std::string name;
+	cv::VideoCapture capture;
+	cv::Mat buffer;
+public:
+	CaptureFrameSource (const std::string &name);
+	virtual bool next (cv::Mat &frame, double &time_produced);
+};
+
+/**
+ * @brief The StreamOutput class writes the lines of a stream to the standard
+ * output, a file or the clients connected to a local socket.  The socket is
+ * created by this class and any number of clients may connect at any time.
+ * Clients receive the lines written after they connect, and lines that a slow
+ * client cannot take are dropped so it does not delay the analysis.  Lines
+ * are dropped whole: the rest of a line that a client took in part is kept
+ * and sent before any other line.
+ */
+class StreamOutput
+{
+	struct Client {
+		int descriptor;
+		/**
+		 * Bytes of the last line that the client has not taken yet.
+		 */
+		std::string pending;
+	};
+	FILE *file;
+	int server;
+	std::string socket_path;
+	std::vector<Client> clients;
+	std::string header;
+	void accept_clients ();
+	static bool send_pending (Client &client);
+public:
+	/**
+	 * @brief StreamOutput Open the given file, the standard output if it is
+	 * - or a local socket if it starts with unix:.
+	 */
+	StreamOutput (const std::string &name);
+	~StreamOutput ();
+	/**
+	 * @brief set_header Set the line written first to the file or to each
+	 * client when it connects.
+	 */
+	void set_header (const std::string &line);
+	void write (const std::string &line);
+};
+
+/**
+ * @brief The StreamStatistics struct accumulates the latency, from the time a
+ * frame is produced to the time its line is written, of a stream.
+ */
+struct StreamStatistics
+{
+	unsigned int number_frames;
+	double sum_latency;
+	double maximum_latency;
+	StreamStatistics ();
+	void add (double latency);
+	void print (FILE *file) const;
+};
+
+/**
+ * @brief run_stream Compute the pixel count difference of the raw frames of a
+ * running experiment, frame by frame, and write a line per frame, in NDJSON
+ * or CSV format, with the number of pixels different from the background
+ * image and from the frame #delta_frame + 1 positions before, per region of
+ * interest.  Only the last #delta_frame + 1 frames are kept, so the work per
+ * frame does not grow with the length of the experiment.
+ *
+ * Runs until the source ends or the process is interrupted.
+ */
+void run_stream (const Experiment &experiment, LiveFrameSource *source, StreamOutput *output, bool csv);
+
+#endif
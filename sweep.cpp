@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include "sweep.hpp"
+#include "experiment.hpp"
+#include "feature-engine.hpp"
+#include "frame-executor.hpp"
+#include "frame-pool.hpp"
+#include "image.hpp"
+
+using namespace std;
+
+static const char *METHOD_NAMES[] = {
+	"raw",
+	"histogram-equalization",
+	"PLSM",
+	"LC",
+};
+
+const char *SweepGrid::method_name (Method method)
+{
+	return METHOD_NAMES [method];
+}
+
+SweepGrid SweepGrid::read (const string &filename, const UserParameters &parameters)
+{
+	SweepGrid result;
+	try {
+		YAML::Node config = YAML::LoadFile (filename);
+		for (const YAML::Node &node : config ["same-colour-threshold"])
+			result.same_colour_thresholds.push_back (node.as<unsigned int> ());
+		for (const YAML::Node &node : config ["delta-frame"])
+			result.delta_frames.push_back (node.as<unsigned int> ());
+		for (const YAML::Node &node : config ["method"]) {
+			string name = node.as<string> ();
+			unsigned int index = find (begin (METHOD_NAMES), end (METHOD_NAMES), name) - begin (METHOD_NAMES);
+			if (index == 4) {
+				fprintf (stderr, "Unknown pre-processing method %s in sweep grid %s!\n", name.c_str (), filename.c_str ());
+				exit (EXIT_FAILURE);
+			}
+			result.methods.push_back ((Method) index);
+		}
+		for (const YAML::Node &node : config ["rectangle"]) {
+			if (!node.IsSequence () || node.size () != 4) {
+				fprintf (stderr, "Rectangle in sweep grid %s must be a list X1, Y1, X2, Y2!\n", filename.c_str ());
+				exit (EXIT_FAILURE);
+			}
+			Rectangle rectangle = {node [0].as<int> (), node [1].as<int> (), node [2].as<int> (), node [3].as<int> ()};
+			// the rectangle crops every frame during the sweep
+			if (rectangle.x1 < 0 || rectangle.x1 >= rectangle.x2 || rectangle.x2 > parameters.frame_size.width
+			    || rectangle.y1 < 0 || rectangle.y1 >= rectangle.y2 || rectangle.y2 > parameters.frame_size.height) {
+				fprintf (stderr, "Rectangle %d,%d,%d,%d in sweep grid %s is not inside the %dx%d frames!\n",
+				         rectangle.x1, rectangle.y1, rectangle.x2, rectangle.y2, filename.c_str (), parameters.frame_size.width, parameters.frame_size.height);
+				exit (EXIT_FAILURE);
+			}
+			result.rectangles.push_back (rectangle);
+		}
+	}
+	catch (const YAML::Exception &exception) {
+		fprintf (stderr, "Could not read sweep grid %s: %s!\n", filename.c_str (), exception.what ());
+		exit (EXIT_FAILURE);
+	}
+	if (result.same_colour_thresholds.empty ())
+		result.same_colour_thresholds.push_back (parameters.get_same_colour_threshold ());
+	if (result.delta_frames.empty ())
+		result.delta_frames.push_back (parameters.delta_frame);
+	if (result.rectangles.empty () && parameters.has_rectangle ())
+		result.rectangles.push_back (Rectangle {parameters.x1, parameters.y1, parameters.x2, parameters.y2});
+	if (result.methods.empty ()) {
+		result.methods = {RAW, HISTOGRAM_EQUALIZATION};
+		if (!result.rectangles.empty ())
+			result.methods.insert (result.methods.end (), {PLSM, LC});
+	}
+	sort (result.delta_frames.begin (), result.delta_frames.end ());
+	result.delta_frames.erase (unique (result.delta_frames.begin (), result.delta_frames.end ()), result.delta_frames.end ());
+	for (Method method : result.methods)
+		if ((method == PLSM || method == LC) && result.rectangles.empty ()) {
+			fprintf (stderr, "Sweep grid %s has light calibrated methods but no rectangle!\n", filename.c_str ());
+			exit (EXIT_FAILURE);
+		}
+	return result;
+}
+
+unsigned int SweepGrid::number_combinations () const
+{
+	unsigned int number_preprocessings = 0;
+	for (Method method : this->methods)
+		number_preprocessings += method == PLSM || method == LC ? this->rectangles.size () : 1;
+	return number_preprocessings * this->delta_frames.size () * this->same_colour_thresholds.size ();
+}
+
+/**
+ * Evaluate every combination of a sweep grid.  Each pre-processing, a method
+ * and, for the light calibrated methods, a rectangle, has its own ring of
+ * previous frames and is processed by the pool of threads.
+ */
+class SweepFeature:
+	public FrameFeature
+{
+	struct Preprocessing {
+		SweepGrid::Method method;
+		int index_rectangle;
+		cv::Mat background;
+		FrameRing ring;
+		ImageScratch scratch;
+		vector<DifferenceHistograms *> histograms;
+		Preprocessing (SweepGrid::Method method, int index_rectangle, const cv::Mat &background, unsigned int capacity):
+			method (method),
+			index_rectangle (index_rectangle),
+			background (background),
+			ring (capacity)
+		{
+		}
+		~Preprocessing ()
+		{
+			for (DifferenceHistograms *histograms : this->histograms)
+				delete histograms;
+		}
+	};
+	const Experiment &experiment;
+	const SweepGrid grid;
+	vector<Preprocessing *> preprocessings;
+	vector<unsigned int> same_colour_levels;
+	/**
+	 * Most common colour of the background image, used by the light
+	 * calibration methods.
+	 */
+	const unsigned int pb;
+	/**
+	 * Most common colour of each rectangle in the current frame.
+	 */
+	vector<unsigned int> pf;
+	Histogram histogram;
+	CacheFile file;
+public:
+	SweepFeature (const Experiment &experiment, const SweepGrid &grid, const string &filename):
+		experiment (experiment),
+		grid (grid),
+		pb (experiment.histogram_background_raw->most_common_colour ()),
+		pf (grid.rectangles.size ()),
+		file (filename)
+	{
+		const unsigned int number_ROIs = experiment.parameters.number_ROIs;
+		const unsigned int capacity = grid.delta_frames.back () + 1;
+		for (SweepGrid::Method method : grid.methods) {
+			if (method == SweepGrid::RAW)
+				this->preprocessings.push_back (new Preprocessing (method, -1, experiment.background, capacity));
+			else if (method == SweepGrid::HISTOGRAM_EQUALIZATION) {
+				cv::Mat background_HE;
+				cv::equalizeHist (experiment.background, background_HE);
+				this->preprocessings.push_back (new Preprocessing (method, -1, background_HE, capacity));
+			}
+			else
+				for (unsigned int index = 0; index < grid.rectangles.size (); index++)
+					this->preprocessings.push_back (new Preprocessing (method, index, experiment.background, capacity));
+		}
+		for (Preprocessing *preprocessing : this->preprocessings) {
+			for (unsigned int index = 0; index < grid.delta_frames.size (); index++)
+				preprocessing->histograms.push_back (new DifferenceHistograms (number_ROIs));
+		}
+		for (unsigned int same_colour_threshold : grid.same_colour_thresholds)
+			this->same_colour_levels.push_back (round ((NUMBER_COLOUR_LEVELS * same_colour_threshold) / 100.0));
+		fprintf (this->file.get (), "method,x1,y1,x2,y2,delta-frame,same-colour-threshold,frame,ROI,difference-background,difference-previous\n");
+	}
+	virtual ~SweepFeature ()
+	{
+		for (Preprocessing *preprocessing : this->preprocessings)
+			delete preprocessing;
+	}
+	virtual unsigned int history () const
+	{
+		return this->grid.delta_frames.back () + 1;
+	}
+	virtual void process (unsigned int index_frame, const cv::Mat &frame)
+	{
+		for (unsigned int index = 0; index < this->grid.rectangles.size (); index++) {
+			const SweepGrid::Rectangle &rectangle = this->grid.rectangles [index];
+			compute_histogram (frame, rectangle.x1, rectangle.y1, rectangle.x2, rectangle.y2, this->histogram);
+			this->pf [index] = this->histogram.most_common_colour ();
+		}
+		WorkerPool &pool = WorkerPool::instance (this->experiment.parameters.number_threads);
+		pool.run ([&] (unsigned int worker) {
+			for (unsigned int index = worker; index < this->preprocessings.size (); index += pool.size ())
+				this->process (*this->preprocessings [index], frame);
+		});
+		for (const Preprocessing *preprocessing : this->preprocessings)
+			this->write (index_frame, *preprocessing);
+	}
+	virtual void finish ()
+	{
+		this->file.commit ();
+	}
+private:
+	void process (Preprocessing &preprocessing, const cv::Mat &frame)
+	{
+		cv::Mat processed;
+		switch (preprocessing.method) {
+		case SweepGrid::RAW:
+			processed = frame;
+			break;
+		case SweepGrid::HISTOGRAM_EQUALIZATION:
+			processed = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+			cv::equalizeHist (frame, processed);
+			break;
+		case SweepGrid::PLSM:
+			processed = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+			light_calibrate_method_PLSM (frame, processed, this->pb, this->pf [preprocessing.index_rectangle]);
+			break;
+		case SweepGrid::LC:
+			processed = FramePool::instance ().acquire (frame.size (), CV_8UC1);
+			light_calibrate_method_LC (frame, processed, this->pb, this->pf [preprocessing.index_rectangle]);
+			break;
+		}
+		// only the histograms of the current frame are kept
+		for (DifferenceHistograms *histograms : preprocessing.histograms)
+			histograms->clear ();
+		compute_difference_histograms_delta_frames (preprocessing.scratch, this->experiment, preprocessing.background, processed, this->grid.delta_frames, &preprocessing.ring, preprocessing.histograms);
+	}
+	void write (unsigned int index_frame, const Preprocessing &preprocessing)
+	{
+		string tuple = SweepGrid::method_name (preprocessing.method);
+		if (preprocessing.index_rectangle >= 0) {
+			const SweepGrid::Rectangle &rectangle = this->grid.rectangles [preprocessing.index_rectangle];
+			tuple += "," + to_string (rectangle.x1) + "," + to_string (rectangle.y1) + "," + to_string (rectangle.x2) + "," + to_string (rectangle.y2);
+		}
+		else
+			tuple += ",,,,";
+		for (unsigned int index_delta = 0; index_delta < this->grid.delta_frames.size (); index_delta++) {
+			const DifferenceHistograms &histograms = *preprocessing.histograms [index_delta];
+			for (unsigned int index_level = 0; index_level < this->same_colour_levels.size (); index_level++)
+				for (unsigned int index_ROI = 0; index_ROI < this->experiment.parameters.number_ROIs; index_ROI++)
+					fprintf (this->file.get (), "%s,%u,%u,%u,%u,%d,%d\n",
+					         tuple.c_str (), this->grid.delta_frames [index_delta], this->grid.same_colour_thresholds [index_level], index_frame, index_ROI + 1,
+					         histograms.number_different_pixels (1, index_ROI, DifferenceHistograms::BACKGROUND, this->same_colour_levels [index_level]),
+					         histograms.number_different_pixels (1, index_ROI, DifferenceHistograms::PREVIOUS, this->same_colour_levels [index_level]));
+		}
+	}
+};
+
+void schedule_sweep (const Experiment &experiment, const SweepGrid &grid, const string &filename, FeatureEngine *engine)
+{
+	fprintf (stderr, "Evaluating %u parameter combinations, results in file %s\n", grid.number_combinations (), filename.c_str ());
+	engine->add (new SweepFeature (experiment, grid, filename));
+}
@@ -0,0 +1,58 @@
+#ifndef __SWEEP__
+#define __SWEEP__
+
+#include <string>
+#include <vector>
+
+#include "parameters.hpp"
+
+class Experiment;
+class FeatureEngine;
+
+/**
+ * @brief The SweepGrid class holds the values of each parameter that a
+ * parameter sweep combines.  Every combination of same colour threshold,
+ * frame gap and pre-processing is evaluated.  The light calibrated
+ * pre-processing methods are combined with every rectangle.
+ */
+class SweepGrid
+{
+public:
+	enum Method {
+		RAW,
+		HISTOGRAM_EQUALIZATION,
+		PLSM,
+		LC
+	};
+	struct Rectangle {
+		int x1, y1, x2, y2;
+	};
+	std::vector<unsigned int> same_colour_thresholds;
+	std::vector<unsigned int> delta_frames;
+	std::vector<Method> methods;
+	std::vector<Rectangle> rectangles;
+	/**
+	 * @brief read Read the grid from a YAML file with a list of values for
+	 * any of the keys same-colour-threshold, delta-frame, method and
+	 * rectangle.  Missing keys take the value of the given parameters.
+	 * Methods are raw, histogram-equalization, PLSM and LC.  Rectangles are
+	 * lists of four coordinates, x1, y1, x2 and y2.
+	 */
+	static SweepGrid read (const std::string &filename, const UserParameters &parameters);
+	unsigned int number_combinations () const;
+	static const char *method_name (Method method);
+};
+
+/**
+ * @brief schedule_sweep Schedule the evaluation of every combination of the
+ * grid in the engine.  Each frame is decoded once and pre-processed once per
+ * method and rectangle, and the differences to all frame gaps are computed in
+ * a single pass over the regions of interest.  Same colour thresholds only
+ * read a different level of the difference histograms.
+ *
+ * The results are written to the given comma separated values file, with a
+ * line per combination, frame and region of interest.
+ */
+void schedule_sweep (const Experiment &experiment, const SweepGrid &grid, const std::string &filename, FeatureEngine *engine);
+
+#endif
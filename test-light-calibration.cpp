@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+#include "light-calibration.hpp"
+
+/*
+ * Check that the lookup tables of the light calibration methods give the
+ * colour levels of the per pixel expressions they replaced, for every most
+ * common colour of the background, pb, and of the frame, pf.
+ */
+
+/**
+ * The PLSM method as it was computed per pixel.  It divides by zero when pf
+ * and the pixel are 255.
+ */
+static void old_light_calibrate_method_PLSM (cv::Mat &frame, unsigned int pb, unsigned int pf)
+{
+	for(int i = 0; i < frame.rows; i++)
+		for(int j = 0; j < frame.cols; j++) {
+			unsigned char old_value = frame.at<unsigned char> (i, j);
+			if (old_value < pf)
+				frame.at<unsigned char> (i, j) = (unsigned int) ((float) (old_value * pb) / pf + 0.5);
+			else
+				frame.at<unsigned char> (i, j) = (unsigned int) (255 - ((float) (255 - old_value) * (255 - pb) / (255 - pf) + 0.5));
+		}
+}
+
+/**
+ * The LC method as it was computed per pixel.  It divides by zero when pf is
+ * zero.
+ */
+static void old_light_calibrate_method_LC (cv::Mat &frame, unsigned int pb, unsigned int pf)
+{
+	for(int i = 0; i < frame.rows; i++)
+		for(int j = 0; j < frame.cols; j++) {
+			unsigned char old_value = frame.at<unsigned char> (i, j);
+			frame.at<unsigned char> (i, j) = std::min (
+			         (unsigned int) ((float) (old_value * pb) / pf + 0.5),
+			         256u);
+		}
+}
+
+/**
+ * Return a frame with a pixel of each colour level.
+ */
+static cv::Mat all_levels ()
+{
+	cv::Mat result (1, LIGHT_CALIBRATION_TABLE_SIZE, CV_8U);
+	for (unsigned int level = 0; level < LIGHT_CALIBRATION_TABLE_SIZE; level++)
+		result.at<unsigned char> (level) = level;
+	return result;
+}
+
+/**
+ * Compare the table and the per pixel expression of a method for every pb,
+ * pf and colour level where the expression does not divide by zero.
+ * @return the number of mismatches.
+ */
+static unsigned int compare (const char *name, void (*method) (cv::Mat &, unsigned int, unsigned int), void (*old_method) (cv::Mat &, unsigned int, unsigned int), bool (*defined) (unsigned int, unsigned int, unsigned int))
+{
+	unsigned int mismatches = 0;
+	for (unsigned int pb = 0; pb < 256; pb++)
+		for (unsigned int pf = 0; pf < 256; pf++) {
+			cv::Mat expected = all_levels ();
+			cv::Mat computed = all_levels ();
+			old_method (expected, pb, pf);
+			method (computed, pb, pf);
+			for (unsigned int level = 0; level < LIGHT_CALIBRATION_TABLE_SIZE; level++)
+				if (defined (pb, pf, level) && expected.at<unsigned char> (level) != computed.at<unsigned char> (level)) {
+					if (mismatches++ < 10)
+						fprintf (stderr, "%s: pb=%u pf=%u level=%u gives %d instead of %d\n", name, pb, pf, level, computed.at<unsigned char> (level), expected.at<unsigned char> (level));
+				}
+		}
+	return mismatches;
+}
+
+static bool defined_PLSM (unsigned int, unsigned int pf, unsigned int level)
+{
+	return pf < 255 || level < 255;
+}
+
+static bool defined_LC (unsigned int, unsigned int pf, unsigned int)
+{
+	return pf > 0;
+}
+
+/**
+ * Check the value of a table entry.
+ * @return the number of mismatches.
+ */
+static unsigned int check_entry (const char *name, void (*table_method) (unsigned int, unsigned int, cv::Mat &), unsigned int pb, unsigned int pf, unsigned int level, unsigned int expected)
+{
+	cv::Mat table;
+	table_method (pb, pf, table);
+	unsigned int computed = table.at<unsigned char> (level);
+	if (computed == expected)
+		return 0;
+	fprintf (stderr, "%s: pb=%u pf=%u level=%u gives %u instead of %u\n", name, pb, pf, level, computed, expected);
+	return 1;
+}
+
+int main ()
+{
+	unsigned int mismatches =
+	      compare ("PLSM", light_calibrate_method_PLSM, old_light_calibrate_method_PLSM, defined_PLSM)
+	      + compare ("LC", light_calibrate_method_LC, old_light_calibrate_method_LC, defined_LC)
+	      // levels scaled to 256 or more wrap to zero
+	      + check_entry ("LC", light_calibration_table_method_LC, 255, 128, 129, 0)
+	      + check_entry ("LC", light_calibration_table_method_LC, 200, 100, 200, 0)
+	      + check_entry ("LC", light_calibration_table_method_LC, 200, 100, 127, 254)
+	      // the inputs where the per pixel expressions divided by zero
+	      + check_entry ("PLSM", light_calibration_table_method_PLSM, 100, 255, 255, 255)
+	      + check_entry ("LC", light_calibration_table_method_LC, 100, 0, 10, 0);
+	if (mismatches > 0) {
+		fprintf (stderr, "%u mismatches\n", mismatches);
+		return EXIT_FAILURE;
+	}
+	fprintf (stderr, "The light calibration tables match the per pixel expressions\n");
+	return EXIT_SUCCESS;
+}
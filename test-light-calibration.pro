@@ -0,0 +1,18 @@
+######################################################################
+# Test that the light calibration lookup tables give the same colour
+# levels as the per pixel expressions they replaced
+######################################################################
+
+TEMPLATE = app
+TARGET = test-light-calibration
+DEPENDPATH += .
+INCLUDEPATH += .
+
+CONFIG += console link_pkgconfig thread c++11
+CONFIG -= qt app_bundle
+PKGCONFIG = opencv
+
+# Input
+HEADERS += light-calibration.hpp
+SOURCES += light-calibration.cpp
+SOURCES += test-light-calibration.cpp
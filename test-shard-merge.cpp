@@ -0,0 +1,213 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "column-table.hpp"
+#include "experiment.hpp"
+#include "feature-engine.hpp"
+#include "frame-manifest.hpp"
+#include "parameters.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+/*
+ * Check that the caches merged from the shards of the frames of an experiment
+ * are the caches of a run over all the frames, with and without chunks.  The
+ * frames are synthetic: the light changes from frame to frame, so the light
+ * calibration of the frames before a shard matters, and a square moves over
+ * the regions of interest.
+ */
+
+static const unsigned int NUMBER_FRAMES = 40;
+static const int FRAME_WIDTH = 64;
+static const int FRAME_HEIGHT = 48;
+
+/**
+ * Options given to every run: a rectangle, so that the light calibrated
+ * features are computed, and other frame gaps of the raw bee speed.
+ */
+static const vector<string> COMMON_OPTIONS = {
+	"--frame-file-type=png",
+	"--number-ROIs=3",
+	"--delta-frame=2",
+	"--delta-frames=1,4",
+	"--rectangle=0,0,32,24",
+	"--checkpoint=8",
+};
+
+/**
+ * Write the background image, the masks and the frames of an experiment in a
+ * new folder.
+ */
+static void write_experiment (const string &folder)
+{
+	if (mkdir (folder.c_str (), 0755) != 0) {
+		fprintf (stderr, "Could not create folder %s!\n", folder.c_str ());
+		exit (EXIT_FAILURE);
+	}
+	cv::Mat background (FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1, cv::Scalar (100));
+	cv::imwrite (folder + "background.png", background);
+	for (int index_mask = 0; index_mask < 3; index_mask++) {
+		cv::Mat mask (FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1, cv::Scalar (0));
+		mask.colRange (index_mask * FRAME_WIDTH / 3, (index_mask + 1) * FRAME_WIDTH / 3).setTo (cv::Scalar (255));
+		cv::imwrite (folder + "Mask-" + to_string (index_mask + 1) + ".png", mask);
+	}
+	FrameNaming naming (DEFAULT_FRAME_NAME_TEMPLATE, "png");
+	for (unsigned int index_frame = 1; index_frame <= NUMBER_FRAMES; index_frame++) {
+		cv::Mat frame (FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
+		unsigned int light = 40 + (index_frame * 37) % 150;
+		for (int y = 0; y < FRAME_HEIGHT; y++)
+			for (int x = 0; x < FRAME_WIDTH; x++)
+				frame.at<unsigned char> (y, x) = light + (x * 7 + y * 13 + index_frame) % 11;
+		frame (cv::Rect ((index_frame * 5) % (FRAME_WIDTH - 8), FRAME_HEIGHT / 3, 8, 8)).setTo (cv::Scalar (240));
+		cv::imwrite (naming.filename (folder, index_frame), frame);
+	}
+}
+
+/**
+ * Parse the options of a run on the given folder.
+ */
+static UserParameters parse (const string &folder, const vector<string> &options)
+{
+	vector<string> arguments (1, "test-shard-merge");
+	arguments.push_back ("--folder=" + folder);
+	arguments.insert (arguments.end (), COMMON_OPTIONS.begin (), COMMON_OPTIONS.end ());
+	arguments.insert (arguments.end (), options.begin (), options.end ());
+	vector<char *> argv;
+	for (string &argument : arguments)
+		argv.push_back (&argument [0]);
+	argv.push_back (NULL);
+	optind = 0;
+	return UserParameters::parse (argv.size () - 1, argv.data ());
+}
+
+/**
+ * Compute the features of the experiment in the given folder, as the batch
+ * tool does.
+ */
+static void compute (const string &folder, const vector<string> &options)
+{
+	UserParameters parameters = parse (folder, options);
+	Experiment experiment (parameters);
+	experiment.set_rect_data (parameters.x1, parameters.y1, parameters.x2, parameters.y2);
+}
+
+/**
+ * Merge the shard files of the caches of the experiment in the given folder.
+ * @return the number of caches that could not be merged.
+ */
+static unsigned int merge (const string &folder)
+{
+	UserParameters parameters = parse (folder, vector<string> ());
+	unsigned int result = 0;
+	for (const string &filename : Experiment::cache_filenames (parameters))
+		if (!merge_cache_table_shards (parameters, filename)) {
+			fprintf (stderr, "Could not merge the shards of %s\n", filename.c_str ());
+			result++;
+		}
+	return result;
+}
+
+/**
+ * Compare the caches of two folders.
+ * @return the number of caches that differ.
+ */
+static unsigned int compare (const string &expected_folder, const string &folder)
+{
+	UserParameters parameters = parse (expected_folder, vector<string> ());
+	unsigned int result = 0;
+	for (const string &expected_filename : Experiment::cache_filenames (parameters)) {
+		string filename = folder + expected_filename.substr (expected_folder.size ());
+		ColumnTable *expected = ColumnTable::open (expected_filename);
+		ColumnTable *table = ColumnTable::open (filename);
+		bool ok =
+		      expected != NULL
+		      && table != NULL
+		      && table->complete ()
+		      && table->number_rows () == expected->number_rows ()
+		      && table->number_columns () == expected->number_columns ()
+		      && table->signature () == expected->signature ();
+		for (unsigned int index_column = 0; ok && index_column < expected->number_columns (); index_column++)
+			ok =
+			      table->column (index_column).width == expected->column (index_column).width
+			      && memcmp (table->row (index_column, 0), expected->row (index_column, 0),
+			                 sizeof (int32_t) * expected->number_rows () * expected->column (index_column).width) == 0;
+		if (!ok) {
+			fprintf (stderr, "Cache %s differs from %s\n", filename.c_str (), expected_filename.c_str ());
+			result++;
+		}
+		delete expected;
+		delete table;
+	}
+	return result;
+}
+
+static void remove_folder (const string &folder)
+{
+	DIR *directory = opendir (folder.c_str ());
+	if (directory == NULL)
+		return ;
+	struct dirent *entry;
+	while ((entry = readdir (directory)) != NULL)
+		if (strcmp (entry->d_name, ".") != 0 && strcmp (entry->d_name, "..") != 0)
+			unlink ((folder + entry->d_name).c_str ());
+	closedir (directory);
+	rmdir (folder.c_str ());
+}
+
+int main ()
+{
+	init ();
+	char root_template[] = "/tmp/test-shard-merge-XXXXXX";
+	if (mkdtemp (root_template) == NULL) {
+		fprintf (stderr, "Could not create a temporary folder!\n");
+		return EXIT_FAILURE;
+	}
+	string root = string (root_template) + "/";
+	string whole_folder = root + "whole/";
+	write_experiment (whole_folder);
+	compute (whole_folder, vector<string> ());
+	struct Case {
+		const char *name;
+		vector<string> options;
+	};
+	const Case cases[] = {
+		{"shards", {}},
+		{"shards-chunks", {"--chunk-size=5", "--threads=2"}},
+	};
+	// the last shard is computed first, it starts within a chunk and after a
+	// checkpoint
+	const char *frame_ranges[] = {"--frame-range=18:40", "--frame-range=1:17"};
+	unsigned int number_failures = 0;
+	for (const Case &a_case : cases) {
+		string folder = root + a_case.name + "/";
+		write_experiment (folder);
+		for (const char *frame_range : frame_ranges) {
+			vector<string> options (a_case.options);
+			options.push_back (frame_range);
+			compute (folder, options);
+		}
+		unsigned int failures = merge (folder) + compare (whole_folder, folder);
+		fprintf (stderr, "%s: %s\n", a_case.name, failures == 0 ? "ok" : "FAILED");
+		number_failures += failures;
+		if (failures == 0)
+			remove_folder (folder);
+	}
+	if (number_failures > 0) {
+		fprintf (stderr, "%u caches differ, the folders are kept in %s\n", number_failures, root.c_str ());
+		return EXIT_FAILURE;
+	}
+	remove_folder (whole_folder);
+	rmdir (root.c_str ());
+	fprintf (stderr, "The merged shards are the caches of a run over all the frames\n");
+	return EXIT_SUCCESS;
+}
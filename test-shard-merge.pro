@@ -0,0 +1,54 @@
+######################################################################
+# Test that the caches merged from shards of the frames are the caches
+# of a run over all the frames
+######################################################################
+
+TEMPLATE = app
+TARGET = test-shard-merge
+DEPENDPATH += .
+INCLUDEPATH += .
+
+CONFIG += console link_pkgconfig thread c++11
+CONFIG -= app_bundle
+PKGCONFIG = opencv
+
+QT = core
+
+# Input
+HEADERS += process-image.hpp
+HEADERS += feature-engine.hpp
+HEADERS += frame-executor.hpp
+HEADERS += frame-source.hpp
+HEADERS += frame-manifest.hpp
+HEADERS += frame-prefetcher.hpp
+HEADERS += frame-pool.hpp
+HEADERS += difference-histograms.hpp
+HEADERS += column-table.hpp
+HEADERS += histogram-index.hpp
+HEADERS += histogram-matrix.hpp
+HEADERS += light-calibration.hpp
+HEADERS += region-map.hpp
+HEADERS += parameters.hpp
+HEADERS += util.hpp
+HEADERS += image.hpp \
+	experiment.hpp \
+	histogram.hpp
+SOURCES += test-shard-merge.cpp
+SOURCES += process-image.cpp
+SOURCES += feature-engine.cpp
+SOURCES += frame-executor.cpp
+SOURCES += frame-source.cpp
+SOURCES += frame-manifest.cpp
+SOURCES += frame-prefetcher.cpp
+SOURCES += frame-pool.cpp
+SOURCES += difference-histograms.cpp
+SOURCES += column-table.cpp
+SOURCES += histogram-index.cpp
+SOURCES += histogram-matrix.cpp
+SOURCES += light-calibration.cpp
+SOURCES += region-map.cpp
+SOURCES += parameters.cpp
+SOURCES += util.cpp
+SOURCES += image.cpp \
+	experiment.cpp \
+	histogram.cpp
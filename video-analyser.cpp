@@ -14,10 +14,12 @@ using namespace std;
 
 static QImage Mat2QImage (const cv::Mat &image, const cv::Mat &mask);
 static double compute_max_range (const QVector<double> &data);
+static double compute_max_range (double maximum);
 
 VideoAnalyser::VideoAnalyser (Experiment &experiment):
 	experiment (experiment),
 	animate (experiment.parameters, &ui),
+	frames_timer (new QTimer (this)),
 	scene (new QGraphicsScene ()),
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
    pixmap (new QGraphicsPixmapItem (NULL, scene)),
@@ -79,14 +81,26 @@ VideoAnalyser::VideoAnalyser (Experiment &experiment):
 		vertical_spinBoxes [i]->setMinimum (0);
 		vertical_spinBoxes [i]->setMaximum (experiment.background.size ().height);
 	}
-	ui.x2SpinBox->setValue (experiment.background.size ().width);
-	ui.y2SpinBox->setValue (experiment.background.size ().height);
+	if (experiment.parameters.has_rectangle ()) {
+		ui.x1SpinBox->setValue (experiment.parameters.x1);
+		ui.y1SpinBox->setValue (experiment.parameters.y1);
+		ui.x2SpinBox->setValue (experiment.parameters.x2);
+		ui.y2SpinBox->setValue (experiment.parameters.y2);
+	}
+	else {
+		ui.x2SpinBox->setValue (experiment.background.size ().width);
+		ui.y2SpinBox->setValue (experiment.background.size ().height);
+	}
+	//   frame gaps of the raw bee speed
+	this->ui.deltaFrameComboBox->addItem (QString::number (experiment.parameters.delta_frame));
+	for (unsigned int delta_frame : experiment.parameters.extra_delta_frames)
+		this->ui.deltaFrameComboBox->addItem (QString::number (delta_frame));
+	this->ui.deltaFrameComboBox->setEnabled (!experiment.parameters.extra_delta_frames.empty ());
 	ui.currentFrameSpinBox->setMinimum (1);
 	ui.currentFrameSpinBox->setMaximum (experiment.parameters.number_frames);
 	//    setup qcustom plot widgets
 	double maximum;
 	QCPGraph *graph;
-	QColor color;
 	auto add_title = [] (auto custom_plot, const char *title) {
 		QFont title_font ("sans", 10, QFont::Bold);
 		custom_plot->plotLayout ()->insertRow (0);
@@ -127,39 +141,11 @@ VideoAnalyser::VideoAnalyser (Experiment &experiment):
 	set_colour_axis (ui.histogramSelectedFramesView->xAxis);
 	ui.histogramSelectedFramesView->xAxis->setLabel ("intensity level");
 	maximum = compute_max_range (*experiment.histogram_background_raw);
-	for (pair<const int, Histogram> &h : *experiment.histogram_frames_all_raw)
-		maximum = std::max (maximum, compute_max_range (h.second));
+	maximum = std::max (maximum, compute_max_range (experiment.histogram_frames_all_raw->maximum ()));
 	ui.histogramSelectedFramesView->yAxis->setRange (0, maximum);
 	ui.histogramSelectedFramesView->yAxis->setLabel ("count");
 	//     qcustom plot widget with histogram of all frames
-	const string labels[] = {
-	  "raw",
-	   "light calibrated most common colour (PLSM)",
-	   "light calibrated most common colour (LC)",
-	};
-	int d = 0;
-	for (const string &a_label : labels) {
-		for (unsigned int i = 0; i < experiment.parameters.number_frames; i++) {
-			ui.histogramAllFramesView->setAutoAddPlottableToLegend (i == 0 || i == experiment.parameters.number_frames - 1);
-			graph = ui.histogramAllFramesView->addGraph ();
-			color = QColor (
-			         255 * i / (experiment.parameters.number_frames - 1),
-			         i <= experiment.parameters.number_frames / 2 ? 255 * i / experiment.parameters.number_frames / 2 : 0,
-			         i > experiment.parameters.number_frames / 2 ? 255 * (i - experiment.parameters.number_frames / 2) / experiment.parameters.number_frames / 2 : 0,
-			         192);
-			color = QColor (
-			         d == 0 ? 255 * i / (experiment.parameters.number_frames - 1) : 63,
-			         d == 1 ? 255 * i / (experiment.parameters.number_frames - 1) : 63,
-			         d == 2 ? 255 * i / (experiment.parameters.number_frames - 1) : 63,
-			         192);
-			graph->setPen (QPen (color, 1, Qt::SolidLine));
-			if (i == 0)
-				graph->setName (("first frame " + a_label).c_str ());
-			else if (i == experiment.parameters.number_frames - 1)
-				graph->setName (("last frame " + a_label).c_str ());
-		}
-		d++;
-	}
+	this->setup_histograms_all_frames ();
 	add_title (ui.histogramAllFramesView, "Histograms of colour intensity");
 	ui.histogramAllFramesView->legend->setVisible (true);
 	set_colour_axis (ui.histogramAllFramesView->xAxis);
@@ -240,9 +226,6 @@ VideoAnalyser::VideoAnalyser (Experiment &experiment):
 	most_common_colour_histogram_no_cropping [0] =
 	most_common_colour_histogram_no_cropping [1] = experiment.histogram_background_raw->most_common_colour ();
 	this->ui.plotColourView->graph (0)->setData (experiment.X_FIRST_LAST_FRAMES, most_common_colour_histogram_no_cropping);
-	for (unsigned int i = 0; i < experiment.parameters.number_frames; i++) {
-		this->ui.histogramAllFramesView->graph (i)->setData (X_COLOURS, (*experiment.histogram_frames_all_raw).operator [] (i));
-	}
 	// setup connection between signals and slots
 	QObject::connect (ui.currentFrameSpinBox, SIGNAL (valueChanged (int)), this, SLOT (update_data (int)));
 	QObject::connect (ui.updateRectPushButton, SIGNAL (clicked ()), this, SLOT (update_rect_data ()));
@@ -262,6 +245,11 @@ VideoAnalyser::VideoAnalyser (Experiment &experiment):
 	QObject::connect (ui.y1SpinBox, SIGNAL (valueChanged (int)), this, SLOT (rectangular_area_changed (int)));
 	QObject::connect (ui.y2SpinBox, SIGNAL (valueChanged (int)), this, SLOT (rectangular_area_changed (int)));
 	QObject::connect (ui.updateSameColourThresholdDataPushButton, SIGNAL (clicked ()), this, SLOT (update_same_colour_data ()));
+	QObject::connect (ui.deltaFrameComboBox, SIGNAL (currentIndexChanged (int)), this, SLOT (update_bee_speed_delta_frame (int)));
+	QObject::connect (this->frames_timer, SIGNAL (timeout ()), this, SLOT (update_frames ()));
+	// frames decoded from a video are fixed
+	if (experiment.parameters.video_filename.empty ())
+		this->frames_timer->start (5000);
 	//
 	this->update_data (this->ui.currentFrameSpinBox->value ());
 }
@@ -305,11 +293,12 @@ void VideoAnalyser::update_displayed_image ()
 	};
 	auto pre_process_frame = [&] (unsigned int index_frame) {
 		if (this->ui.noPreProcessedImageRadioButton->isChecked ())
-			return read_frame (experiment.parameters, index_frame);
+			// the displayed image is modified in place
+			return read_frame (experiment.parameters, index_frame).clone ();
 		else if (this->ui.lightCalibratedPLSMMethodRadioButton->isChecked ())
-			return light_calibrate (this->experiment, index_frame, x1, y1, x2, y2, light_calibrate_method_PLSM);
+			return light_calibrate (this->scratch, this->experiment, index_frame, x1, y1, x2, y2, light_calibrate_method_PLSM);
 		else if (this->ui.lightCalibratedLCMethodRadioButton->isChecked ())
-			return light_calibrate (this->experiment, index_frame, x1, y1, x2, y2, light_calibrate_method_LC);
+			return light_calibrate (this->scratch, this->experiment, index_frame, x1, y1, x2, y2, light_calibrate_method_LC);
 		else if (ui.histogramEqualisationRadioButton->isChecked ()) {
 			cv::Mat result;
 			cv::Mat frame = read_frame (experiment.parameters, index_frame);
@@ -395,7 +384,7 @@ void VideoAnalyser::update_rect_data ()
 	this->experiment.set_rect_data (x1, y1, x2, y2);
 	// histograms of selected frames
 	//    histogram of current frame - no cropping
-	this->ui.histogramSelectedFramesView->graph (2)->setData (X_COLOURS, (*this->experiment.histogram_frames_rect_raw) [current_frame]);
+	this->ui.histogramSelectedFramesView->graph (2)->setData (X_COLOURS, this->experiment.histogram_frames_rect_raw->histogram (current_frame));
 	//    histogram of background - cropped rectangle
 	cv::Mat cropped (this->experiment.background, cv::Range (y1, y2), cv::Range (x1, x2));
 	Histogram histogram;
@@ -429,11 +418,11 @@ void VideoAnalyser::update_rect_data ()
 	for (unsigned int i = 0; i < experiment.parameters.number_frames; i++) {
 		this->ui.histogramAllFramesView->graph (i + experiment.parameters.number_frames)->setData (
 		      X_COLOURS,
-		      this->experiment.histogram_frames_light_calibrated_most_common_colour_method_PLSM->operator [] (i),
+		      this->experiment.histogram_frames_light_calibrated_most_common_colour_method_PLSM->histogram (i + 1),
 		      true);
 		this->ui.histogramAllFramesView->graph (i + 2 * experiment.parameters.number_frames)->setData (
 		      X_COLOURS,
-		      this->experiment.histogram_frames_light_calibrated_most_common_colour_method_LC->operator [] (i),
+		      this->experiment.histogram_frames_light_calibrated_most_common_colour_method_LC->histogram (i + 1),
 		      true);
 	}
 	this->ui.histogramAllFramesView->replot ();
@@ -516,16 +505,79 @@ void VideoAnalyser::rectangular_area_changed (int)
 void VideoAnalyser::update_same_colour_data ()
 {
 	printf ("SCT=%d\n", this->ui.sameColourThresholdSpinBox->value ());
-	this->experiment.parameters.set_same_colour_threshold (this->ui.sameColourThresholdSpinBox->value ());
-	this->experiment.pixel_count_difference_raw = compute_pixel_count_difference_raw (this->experiment);
-	this->experiment.pixel_count_difference_histogram_equalisation = compute_pixel_count_difference_histogram_equalization (this->experiment);
+	this->experiment.update_same_colour_data (this->ui.sameColourThresholdSpinBox->value ());
+	// update the QCustomPlots
+	this->update_pixel_count_difference_plots ();
+}
+
+void VideoAnalyser::update_bee_speed_delta_frame (int)
+{
+	const std::vector<QVector<double> > *pcd = this->selected_pixel_count_difference_raw ();
+	for (unsigned int i = 0; i < experiment.parameters.number_ROIs; i++)
+		this->ui.plotBeeSpeedView->graph (i)->setData (experiment.X_FRAMES, (*pcd) [i * 2 + 1]);
+	this->ui.plotBeeSpeedView->replot ();
+}
+
+void VideoAnalyser::update_frames ()
+{
+	if (!this->experiment.update_frames ())
+		return ;
+	unsigned int number_frames = this->experiment.parameters.number_frames;
+	this->ui.currentFrameSpinBox->setMaximum (number_frames);
+	QCustomPlot *frame_plots[] = {this->ui.plotColourView, this->ui.plotBeeSpeedView, this->ui.plotNumberBeesView};
+	for (QCustomPlot *a_plot : frame_plots)
+		a_plot->xAxis->setRange (0, number_frames);
+	this->ui.plotColourView->graph (0)->setData (experiment.X_FIRST_LAST_FRAMES, most_common_colour_histogram_no_cropping);
 	if (this->experiment.highest_colour_level_frames_rect != NULL) {
-		this->experiment.pixel_count_difference_light_calibrated_most_common_colour_method_PLSM =
-		      compute_pixel_count_difference_light_calibrated_most_common_colour_method_PLSM (this->experiment);
-		this->experiment.pixel_count_difference_light_calibrated_most_common_colour_method_LC =
-		      compute_pixel_count_difference_light_calibrated_most_common_colour_method_LC (this->experiment);
+		this->ui.plotColourView->graph (1)->setData (experiment.X_FRAMES, *this->experiment.highest_colour_level_frames_rect);
+		this->ui.plotColourView->graph (2)->setData (experiment.X_FIRST_LAST_FRAMES, most_common_colour_histogram_cropped_rectangle);
 	}
-	// update the QCustomPlots
+	this->ui.plotColourView->replot ();
+	this->update_pixel_count_difference_plots ();
+	this->setup_histograms_all_frames ();
+	this->update_displayed_histograms_all_frames ();
+	this->update_data (this->ui.currentFrameSpinBox->value ());
+}
+
+// VideoAnalyser PRIVATE METHODS
+
+void VideoAnalyser::setup_histograms_all_frames ()
+{
+	const string labels[] = {
+	  "raw",
+	   "light calibrated most common colour (PLSM)",
+	   "light calibrated most common colour (LC)",
+	};
+	HistogramMatrix *histograms[] = {
+	   experiment.histogram_frames_all_raw,
+	   experiment.histogram_frames_light_calibrated_most_common_colour_method_PLSM,
+	   experiment.histogram_frames_light_calibrated_most_common_colour_method_LC,
+	};
+	this->ui.histogramAllFramesView->clearGraphs ();
+	int d = 0;
+	for (const string &a_label : labels) {
+		for (unsigned int i = 0; i < experiment.parameters.number_frames; i++) {
+			ui.histogramAllFramesView->setAutoAddPlottableToLegend (i == 0 || i == experiment.parameters.number_frames - 1);
+			QCPGraph *graph = ui.histogramAllFramesView->addGraph ();
+			QColor color (
+			         d == 0 ? 255 * i / (experiment.parameters.number_frames - 1) : 63,
+			         d == 1 ? 255 * i / (experiment.parameters.number_frames - 1) : 63,
+			         d == 2 ? 255 * i / (experiment.parameters.number_frames - 1) : 63,
+			         192);
+			graph->setPen (QPen (color, 1, Qt::SolidLine));
+			if (i == 0)
+				graph->setName (("first frame " + a_label).c_str ());
+			else if (i == experiment.parameters.number_frames - 1)
+				graph->setName (("last frame " + a_label).c_str ());
+			if (histograms [d] != NULL)
+				graph->setData (X_COLOURS, histograms [d]->histogram (i + 1), d > 0);
+		}
+		d++;
+	}
+}
+
+void VideoAnalyser::update_pixel_count_difference_plots ()
+{
 	this->update_PCD_plots_yAxis_range ();
 	std::vector<QVector<double> > *pixel_count_difference[] = {
 	   experiment.pixel_count_difference_raw,
@@ -542,11 +594,18 @@ void VideoAnalyser::update_same_colour_data ()
 			}
 		d += experiment.parameters.number_ROIs;
 	}
-	this->ui.plotBeeSpeedView->replot ();
+	this->update_bee_speed_delta_frame (this->ui.deltaFrameComboBox->currentIndex ());
 	this->ui.plotNumberBeesView->replot ();
 }
 
-// VideoAnalyser PRIVATE METHODS
+const std::vector<QVector<double> > *VideoAnalyser::selected_pixel_count_difference_raw () const
+{
+	int index = this->ui.deltaFrameComboBox->currentIndex ();
+	if (index <= 0)
+		return experiment.pixel_count_difference_raw;
+	unsigned int delta_frame = experiment.parameters.extra_delta_frames [index - 1];
+	return experiment.pixel_count_difference_raw_delta_frames->at (delta_frame);
+}
 
 bool VideoAnalyser::displayed_image_has_histogram_to_show ()
 {
@@ -562,12 +621,9 @@ bool VideoAnalyser::displayed_image_has_histogram_to_show ()
 
 void VideoAnalyser::update_histograms_current_frame (int current_frame)
 {
-	const Histogram &histogram = (*this->experiment.histogram_frames_all_raw) [current_frame];
-	this->ui.histogramSelectedFramesView->graph (0)->setData (X_COLOURS, histogram);
-	if (this->experiment.histogram_frames_rect_raw != NULL) {
-		const Histogram &histogram = (*this->experiment.histogram_frames_rect_raw) [current_frame];
-		this->ui.histogramSelectedFramesView->graph (2)->setData (X_COLOURS, histogram);
-	}
+	this->ui.histogramSelectedFramesView->graph (0)->setData (X_COLOURS, this->experiment.histogram_frames_all_raw->histogram (current_frame));
+	if (this->experiment.histogram_frames_rect_raw != NULL)
+		this->ui.histogramSelectedFramesView->graph (2)->setData (X_COLOURS, this->experiment.histogram_frames_rect_raw->histogram (current_frame));
 	this->ui.histogramSelectedFramesView->replot ();
 }
 
@@ -677,6 +733,14 @@ double compute_max_range (const QVector<double> &data)
 	double maximum = data [0];
 	for (double x : data)
 		maximum = max (x, maximum);
+	return compute_max_range (maximum);
+}
+
+/**
+ * Return a round upper bound of the given maximum for a plot axis.
+ */
+double compute_max_range (double maximum)
+{
 	if (maximum == 0)
 		return 0;
 	double power = ceil (log10 (maximum));
@@ -2,6 +2,7 @@
 #define __VIDEO_ANALYSER__
 
 #include <QtCore/qglobal.h>
+#include <QtCore/QTimer>
 #include <QGraphicsRectItem>
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
@@ -36,8 +37,18 @@ public slots:
 	void update_displayed_histograms_all_frames ();
 	void rectangular_area_changed (int);
 	void update_same_colour_data ();
+	void update_bee_speed_delta_frame (int);
+	/**
+	 * @brief update_frames Check if frames were added to the folder and, if
+	 * so, extend the data and the plots with them.
+	 */
+	void update_frames ();
 private:
 	Animate animate;
+	/**
+	 * Periodically checks for frames added to the folder.
+	 */
+	QTimer *frames_timer;
 	QGraphicsScene *scene;
 	QGraphicsPixmapItem *pixmap;
 	QGraphicsRectItem *roi;
@@ -48,7 +59,24 @@ private:
 	QVector<double> most_common_colour_histogram_cropped_rectangle;
 	std::vector<QColor> mask_colour;
 	cv::Mat displayed_image;
+	/**
+	 * Scratch data used to process the displayed frames.
+	 */
+	ImageScratch scratch;
 	bool displayed_image_has_histogram_to_show ();
+	/**
+	 * Return the raw pixel count difference data for the frame gap selected in
+	 * the delta frame combo box.
+	 */
+	const std::vector<QVector<double> > *selected_pixel_count_difference_raw () const;
+	/**
+	 * Create the graphs of the histograms of every frame.
+	 */
+	void setup_histograms_all_frames ();
+	/**
+	 * Show the pixel count difference data of all pre-processing methods.
+	 */
+	void update_pixel_count_difference_plots ();
 	void update_histograms_current_frame (int current_frame);
 	void update_histogram_displayed_image ();
 	void update_histogram_item (int intensity_analyse, int same_intensity_level);